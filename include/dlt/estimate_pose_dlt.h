@@ -4,6 +4,8 @@
 #include <optional>
 
 #include "Eigen/Core"
+#include "Eigen/Geometry"
+#include "Eigen/SVD"
 #include "glog/logging.h"
 
 namespace uzh {
@@ -193,6 +195,41 @@ CameraMatrixDLT EstimatePoseDLT(
   return M_dlt;
 }
 
+//@brief Fixed-size counterpart of EstimatePoseDLT for exactly N
+// correspondences, e.g. the minimal samples of RANSAC, where nothing is
+// allocated.
+//@param normalized_points [2xN] observations in normalized coordinates, i.e.
+// pre-multiplied with the inverse of the calibration matrix K.
+//@param object_points [3xN] 3D reference points, expressed in inhomogeneous
+// representation.
+//@param K Calibration matrix, kept for CameraMatrixDLT::DecomposeDLT.
+//@return Camera [3x4] matrix M = [R|t], see EstimatePoseDLT.
+template <int N>
+CameraMatrixDLT EstimateMinimalPoseDLT(
+    const Eigen::Matrix<double, 2, N>& normalized_points,
+    const Eigen::Matrix<double, 3, N>& object_points,
+    const Eigen::Matrix3d& K) {
+  static_assert(N >= 6, "DLT requires at least 6 correspondences.");
+  // Populate Q as in EstimatePoseDLT.
+  Eigen::Matrix<double, 2 * N, 12> Q;
+  for (int i = 0; i < N; ++i) {
+    const double x = normalized_points(0, i), y = normalized_points(1, i);
+    const double X = object_points(0, i), Y = object_points(1, i),
+                 Z = object_points(2, i);
+    Q.row(2 * i) << X, Y, Z, 1, 0, 0, 0, 0, -x * X, -x * Y, -x * Z, -x;
+    Q.row(2 * i + 1) << 0, 0, 0, 0, -X, -Y, -Z, -1, y * X, y * Y, y * Z, y;
+  }
+  const Eigen::JacobiSVD<Eigen::Matrix<double, 2 * N, 12>> svd(
+      Q, Eigen::ComputeFullV);
+  const Eigen::Matrix<double, 12, 1> smallest_singular_vector =
+      svd.matrixV().col(11);
+  CameraMatrixDLT M_dlt;
+  M_dlt.setM(Eigen::Map<const Eigen::Matrix<double, 3, 4, Eigen::RowMajor>>(
+      smallest_singular_vector.data()));
+  M_dlt.setK(K);
+  return M_dlt;
+}
+
 }  // namespace uzh
 
 #endif  // UZH_DLT_ESTIMATE_POSE_DLT_H_
\ No newline at end of file
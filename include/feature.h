@@ -3,10 +3,12 @@
 
 #include "feature/descriptor.h"
 #include "feature/distance.h"
+#include "feature/extract_patch.h"
 #include "feature/harris.h"
 #include "feature/keypoint.h"
 #include "feature/matching.h"
 #include "feature/pad_array.h"
+#include "feature/quantized_matching.h"
 #include "feature/shi_tomasi.h"
 
 #endif  // UZH_FEATURE_H_
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef UZH_FEATURE_EXTRACT_PATCH_H_
+#define UZH_FEATURE_EXTRACT_PATCH_H_
+
+#include <algorithm>  // std::min, std::max
+
+#include "opencv2/core.hpp"
+
+namespace uzh {
+
+//@brief Policies deciding how the pixels outside of the image are sampled.
+// BORDER_CLAMP: replicate the nearest pixel on the border.
+// BORDER_ZERO: treat the pixels outside as zeros. Identical to sampling from
+// an image zero-padded with PadArray.
+// BORDER_SKIP: reject patches crossing the border.
+enum BorderPolicy : int { BORDER_CLAMP, BORDER_ZERO, BORDER_SKIP };
+
+//@brief Return true if the patch centered at (row, col) with radius
+// patch_radius lies entirely inside the image.
+inline bool IsPatchInside(const cv::Mat& image, const int row, const int col,
+                          const int patch_radius) {
+  return row - patch_radius >= 0 && col - patch_radius >= 0 &&
+         row + patch_radius < image.rows && col + patch_radius < image.cols;
+}
+
+//@brief Extract the square patch centered at (row, col) from the unpadded
+// single channel image.
+//@param image Input image whose depth corresponds to T.
+//@param row Row index of the patch center.
+//@param col Col index of the patch center.
+//@param patch_radius Radius of the patch, i.e. the patch is of size
+// (2 * patch_radius + 1) x (2 * patch_radius + 1).
+//@param patch Output buffer. The patch is unrolled column by column, i.e. the
+// pixel (r, c) of the patch is written to patch[(c * patch_size + r) *
+// stride]. This is the same layout as the one of a column-major matrix.
+//@param border_policy How to sample the pixels outside of the image.
+//@param stride Distance between two consecutive outputs in patch.
+//@return False if the patch crosses the border and border_policy is
+// BORDER_SKIP, in which case nothing is written. True otherwise.
+//! Patches away from the border take the fast path without bounds checks.
+template <typename T, typename U>
+bool ExtractPatch(const cv::Mat& image, const int row, const int col,
+                  const int patch_radius, U* patch,
+                  const int border_policy = uzh::BORDER_ZERO,
+                  const int stride = 1) {
+  const int patch_size = 2 * patch_radius + 1;
+
+  // Fast path.
+  if (IsPatchInside(image, row, col, patch_radius)) {
+    for (int r = 0; r < patch_size; ++r) {
+      const T* src = image.ptr<T>(row - patch_radius + r) + col - patch_radius;
+      U* dst = patch + r * stride;
+      for (int c = 0; c < patch_size; ++c) {
+        dst[c * patch_size * stride] = cv::saturate_cast<U>(src[c]);
+      }
+    }
+    return true;
+  }
+
+  if (border_policy == uzh::BORDER_SKIP) return false;
+
+  for (int r = 0; r < patch_size; ++r) {
+    int y = row - patch_radius + r;
+    const bool row_inside = y >= 0 && y < image.rows;
+    y = std::min(std::max(y, 0), image.rows - 1);
+    const T* src = image.ptr<T>(y);
+    U* dst = patch + r * stride;
+    for (int c = 0; c < patch_size; ++c) {
+      int x = col - patch_radius + c;
+      const bool inside = row_inside && x >= 0 && x < image.cols;
+      x = std::min(std::max(x, 0), image.cols - 1);
+      dst[c * patch_size * stride] =
+          inside || border_policy == uzh::BORDER_CLAMP
+              ? cv::saturate_cast<U>(src[x])
+              : U(0);
+    }
+  }
+  return true;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_FEATURE_EXTRACT_PATCH_H_
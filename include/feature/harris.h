@@ -151,18 +151,17 @@ void HarrisResponse(const cv::Mat& image_, cv::Mat& harris_response,
   const int sobel_radius = static_cast<int>(std::floor(sobel_hor.rows / 2));
   // Assume the kernels are square, then starting_x = starting_y.
   const int starting_x = sobel_radius + patch_radius, starting_y = starting_x;
-  Eigen::MatrixXd response_valid =
-      response.block(starting_x, starting_y, valid_rows, valid_cols);
 
-  // Convert back to cv::Mat and store it to the output harris_response.
-  cv::eigen2cv(response_valid, harris_response);
-
-  // Pad the harris_response making its size consistent with the input image.
-  // And set the pixels on borders to 0.
+  // Set the pixels outside of the valid block to 0 in place, rather than
+  // cropping the valid block and padding it back to the size of the input
+  // image. The border width is radius(B1) + radius(B2).
+  response.topRows(starting_x).setZero();
+  response.bottomRows(response.rows() - starting_x - valid_rows).setZero();
+  response.leftCols(starting_y).setZero();
+  response.rightCols(response.cols() - starting_y - valid_cols).setZero();
 
-  // The pad_size is computed as size(padding) = radius(B1) + radius(B2).
-  const int pad_size = sobel_radius + patch_radius;
-  PadArray(harris_response, {pad_size, pad_size, pad_size, pad_size});
+  // Convert back to cv::Mat and store it to the output harris_response.
+  cv::eigen2cv(response, harris_response);
   assert((harris_response.rows == image.rows) &&
          (harris_response.cols == image.cols));
 }
@@ -1,8 +1,9 @@
 #ifndef UZH_FEATURE_KEYPOINTS_H_
 #define UZH_FEATURE_KEYPOINTS_H_
 
+#include <algorithm>  // std::max, std::min
+
 #include "Eigen/Core"
-#include "feature/pad_array.h"
 #include "opencv2/core.hpp"
 #include "opencv2/core/eigen.hpp"
 
@@ -24,17 +25,12 @@ namespace uzh {
 // the top num_keypoints ranked by response strength - works generally well.
 void SelectKeypoints(const cv::Mat& response, cv::Mat& keypoints,
                      const int num_keypoints, const int non_maximum_radius) {
-  // Pad the response matrix for use in the non-maximum suppression stage later
-  // on.
-  const cv::Scalar_<int> pad_size{non_maximum_radius, non_maximum_radius,
-                                  non_maximum_radius, non_maximum_radius};
-  cv::Mat_<double> response_tmp = response.clone();
-  uzh::PadArray(response_tmp, pad_size);
-
   // Use eigen to speed up the computation
+  //! The conversion is the only copy of the response made. No padding is
+  //! needed as the suppression window is clamped to the borders below.
   Eigen::MatrixXd res;
   Eigen::Matrix2Xi kpts(2, num_keypoints);
-  cv::cv2eigen(response_tmp, res);
+  cv::cv2eigen(response, res);
 
   // Select the top num_keypoints based on their responses and store the
   // corresponding x and y coordinates(indices) to the k matrix in order.
@@ -42,19 +38,24 @@ void SelectKeypoints(const cv::Mat& response, cv::Mat& keypoints,
   Eigen::Index row, col;
   for (int i = 0; i < num_keypoints; ++i) {
     res.maxCoeff(&row, &col);
-    //! Minus the non_maximum_radius to compensate for the pre-padding.
-    kpts.col(i) = Eigen::Vector2i((int)row - non_maximum_radius,
-                                  (int)col - non_maximum_radius);
+    kpts.col(i) = Eigen::Vector2i((int)row, (int)col);
 
     // Perform non-maximum suppresion: set the pixels within the circle of
     // non_maximum_radius radius to 0 including the keypoints we previously
     // selected. This assures the next keypoint won't be coincident with the
     // ones selected before.
     //! We adopt a box filter to simplify the codes.
-    //! Due the pre-padding, no need to worry about boundary issues.
-    res.block(row - non_maximum_radius, col - non_maximum_radius,
-              2 * non_maximum_radius + 1, 2 * non_maximum_radius + 1)
-        .setZero();
+    //! The box is clamped to the borders, which is equivalent to suppressing
+    //! on a padded response.
+    const Eigen::Index top =
+        std::max<Eigen::Index>(row - non_maximum_radius, 0);
+    const Eigen::Index left =
+        std::max<Eigen::Index>(col - non_maximum_radius, 0);
+    const Eigen::Index bottom =
+        std::min<Eigen::Index>(row + non_maximum_radius, res.rows() - 1);
+    const Eigen::Index right =
+        std::min<Eigen::Index>(col + non_maximum_radius, res.cols() - 1);
+    res.block(top, left, bottom - top + 1, right - left + 1).setZero();
   }
 
   // Convert back to cv::Mat
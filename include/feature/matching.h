@@ -30,9 +30,14 @@ namespace uzh
   // keypoint in the query_keypoints.
   //@param distance_ratio A parameter controls the range of the acceptable
   // SSD distance within which two descriptors will be viewed as matched.
+  //@param match_distances If not nullptr, set to a [1 x q] row vector of type
+  // CV_64F where the i-th column contains the distance between the i-th query
+  // descriptor and its nearest database descriptor, which ranks the
+  // reliability of the matches, e.g. for ProsacSampler.
   void MatchDescriptors(const cv::Mat &query_descriptors,
                         const cv::Mat &database_descriptors, cv::Mat &matches_,
-                        const double distance_ratio)
+                        const double distance_ratio,
+                        cv::Mat *match_distances = nullptr)
   {
     // Convert to Eigen::Matrix
     Eigen::MatrixXd query, database;
@@ -85,6 +90,10 @@ namespace uzh
 
     // Convert back to cv::Mat
     cv::eigen2cv(unique_matches, matches_);
+    if (match_distances != nullptr)
+    {
+      cv::eigen2cv(distances, *match_distances);
+    }
   }
 
   //@brief Draw a line between each matched pair of keypoints.
@@ -0,0 +1,168 @@
+#ifndef UZH_FEATURE_QUANTIZED_MATCHING_H_
+#define UZH_FEATURE_QUANTIZED_MATCHING_H_
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "opencv2/core.hpp"
+
+namespace uzh {
+
+//@brief Squared Euclidean distance between two uint8 vectors, e.g. quantized
+// SIFT descriptors.
+//! The bytes are widened to int16, subtracted and squared-and-summed pairwise
+//! into int32 with the widening multiply-add, 32 bytes per iteration with AVX2
+//! and 16 bytes with SSE2. The remainder is handled by scalar code, which is
+//! also the fallback on other architectures. No overflow happens for n < 33026.
+//@param p Pointer to the first vector.
+//@param q Pointer to the second vector.
+//@param n Length of the vectors.
+inline int SquaredEuclideanU8(const unsigned char* p, const unsigned char* q,
+                              const int n) {
+  int k = 0;
+  int sum = 0;
+#if defined(__AVX2__)
+  {
+    const __m256i kZero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    for (; k + 32 <= n; k += 32) {
+      const __m256i a =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + k));
+      const __m256i b =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + k));
+      //! The unpacks interleave within 128-bit lanes, which does not matter
+      //! since a and b are permuted alike and the result is summed up.
+      const __m256i d_lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(a, kZero),
+                                            _mm256_unpacklo_epi8(b, kZero));
+      const __m256i d_hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(a, kZero),
+                                            _mm256_unpackhi_epi8(b, kZero));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(d_lo, d_lo));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(d_hi, d_hi));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                              _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum += _mm_cvtsi128_si32(s);
+  }
+#endif
+#if defined(__SSE2__)
+  {
+    const __m128i kZero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    for (; k + 16 <= n; k += 16) {
+      const __m128i a =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + k));
+      const __m128i b =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + k));
+      const __m128i d_lo = _mm_sub_epi16(_mm_unpacklo_epi8(a, kZero),
+                                         _mm_unpacklo_epi8(b, kZero));
+      const __m128i d_hi = _mm_sub_epi16(_mm_unpackhi_epi8(a, kZero),
+                                         _mm_unpackhi_epi8(b, kZero));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(d_lo, d_lo));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(d_hi, d_hi));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum += _mm_cvtsi128_si32(acc);
+  }
+#endif
+  for (; k < n; ++k) {
+    const int d = static_cast<int>(p[k]) - static_cast<int>(q[k]);
+    sum += d * d;
+  }
+  return sum;
+}
+
+//@brief Match quantized descriptors exhaustively with the distance ratio test.
+//! A query descriptor is matched to its nearest database descriptor if the
+//! distance to it is below max_ratio times the distance to the second nearest
+//! one. All distances are computed in integer arithmetic with
+//! SquaredEuclideanU8, hence the ratio is compared in squared form.
+//@param query_descriptors [m x q] matrix where each column is a descriptor,
+// e.g. from QuantizeSIFTDescriptors.
+//@param database_descriptors [m x p] matrix where each column is a descriptor.
+//@param max_ratio Distance ratio threshold in (0, 1].
+//@return index_pairs -- [2 x k] matrix where each column contains the indices
+// of a query descriptor and of the matched database descriptor; distances --
+// [1 x k] Euclidean distances of the matched pairs.
+std::tuple<arma::umat /*index_pairs*/, arma::rowvec /*distances*/>
+MatchQuantizedDescriptors(const arma::Mat<unsigned char>& query_descriptors,
+                          const arma::Mat<unsigned char>& database_descriptors,
+                          const double max_ratio = 0.8) {
+  if (query_descriptors.n_rows != database_descriptors.n_rows)
+    LOG(ERROR) << "The dimensions of the descriptors are not consistent.";
+  const int kDim = query_descriptors.n_rows;
+  const double kMaxSquaredRatio = max_ratio * max_ratio;
+
+  std::vector<arma::uword> index_pairs;
+  std::vector<double> distances;
+  for (arma::uword i = 0; i < query_descriptors.n_cols; ++i) {
+    const unsigned char* query = query_descriptors.colptr(i);
+    int best = std::numeric_limits<int>::max();
+    int second_best = std::numeric_limits<int>::max();
+    arma::uword best_index = 0;
+    for (arma::uword j = 0; j < database_descriptors.n_cols; ++j) {
+      const int d =
+          SquaredEuclideanU8(query, database_descriptors.colptr(j), kDim);
+      if (d < best) {
+        second_best = best;
+        best = d;
+        best_index = j;
+      } else if (d < second_best) {
+        second_best = d;
+      }
+    }
+    if (database_descriptors.n_cols == 0 ||
+        (database_descriptors.n_cols > 1 &&
+         best >= kMaxSquaredRatio * second_best))
+      continue;
+    index_pairs.push_back(i);
+    index_pairs.push_back(best_index);
+    distances.push_back(std::sqrt(static_cast<double>(best)));
+  }
+
+  const arma::uword kNumMatches = distances.size();
+  if (kNumMatches == 0) return {arma::umat(2, 0), arma::rowvec()};
+  return {arma::umat(index_pairs.data(), 2, kNumMatches),
+          arma::rowvec(distances)};
+}
+
+//@brief Overloaded for cv::Mat, e.g. the descriptors of a MappedFeatureFile.
+//@param query_descriptors [m x q] CV_8U matrix where each column is a
+// descriptor. Since the bytes of a column are strided, the matrix is
+// transposed once such that each descriptor is contiguous.
+//@param database_descriptors [m x p] CV_8U matrix.
+std::tuple<arma::umat /*index_pairs*/, arma::rowvec /*distances*/>
+MatchQuantizedDescriptors(const cv::Mat& query_descriptors,
+                          const cv::Mat& database_descriptors,
+                          const double max_ratio = 0.8) {
+  if (query_descriptors.type() != CV_8U ||
+      database_descriptors.type() != CV_8U)
+    LOG(ERROR) << "Only CV_8U descriptors supported.";
+
+  // The transpose of a [m x n] row-major matrix is the [m x n] column-major
+  // matrix.
+  const auto to_arma = [](const cv::Mat& descriptors) {
+    cv::Mat transposed;
+    cv::transpose(descriptors, transposed);
+    return arma::Mat<unsigned char>(transposed.ptr<unsigned char>(),
+                                    descriptors.rows, descriptors.cols);
+  };
+  return MatchQuantizedDescriptors(to_arma(query_descriptors),
+                                   to_arma(database_descriptors), max_ratio);
+}
+
+}  // namespace uzh
+
+#endif  // UZH_FEATURE_QUANTIZED_MATCHING_H_
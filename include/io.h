@@ -1,6 +1,9 @@
 #ifndef UZH_IO_H_
 #define UZH_IO_H_
 
+#include "io/feature_cache.h"
+#include "io/feature_file.h"
+#include "io/filesystem.h"
 #include "io/load.h"
 
 #endif  // UZH_IO_H_
\ No newline at end of file
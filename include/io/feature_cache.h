@@ -0,0 +1,104 @@
+#ifndef UZH_IO_FEATURE_CACHE_H_
+#define UZH_IO_FEATURE_CACHE_H_
+
+#include <cstdint>
+#include <cstdio>  // std::rename
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "glog/logging.h"
+#include "io/feature_file.h"
+#include "io/filesystem.h"
+#include "opencv2/core.hpp"
+
+namespace uzh {
+
+//@brief On-disk cache of the features of images, stored as feature files.
+//! An entry is keyed on the image path, the modification time of the image and
+//! a string encoding the detector and descriptor parameters, such that
+//! re-running an executable or sweeping a parameter only detects the features
+//! that are not cached yet. An edited image gets a new key, and stale entries
+//! are simply never hit again.
+class FeatureCache {
+ public:
+  //@param cache_dir Directory holding the feature files, created if needed.
+  explicit FeatureCache(const std::string& cache_dir) : cache_dir_(cache_dir) {
+    std::error_code error;
+    uzh::fs::create_directories(cache_dir_, error);
+    if (error) LOG(ERROR) << "Cannot create " << cache_dir_ << ": " << error;
+  }
+
+  //@brief Path of the feature file of an image.
+  //@param image_file Path of the image.
+  //@param params Parameters of the detector and the descriptor, e.g.
+  // cv::format("harris %d %g %d %d", patch_size, kappa, ...).
+  std::string Path(const std::string& image_file,
+                   const std::string& params) const {
+    //! The modification time is only compared for equality, hence the clock
+    //! and the unit of the ticks do not matter.
+    std::error_code error;
+    std::int64_t mtime = 0;
+    const auto kWriteTime = uzh::fs::last_write_time(image_file, error);
+    if (!error)
+      mtime = static_cast<std::int64_t>(kWriteTime.time_since_epoch().count());
+    else
+      LOG(ERROR) << "Cannot stat " << image_file << ": " << error;
+    std::string canonical = uzh::fs::canonical(image_file, error).string();
+    if (error) canonical = image_file;
+
+    std::ostringstream key;
+    key << canonical << '\n' << mtime << '\n' << params;
+    const unsigned long long kHash = Hash(key.str());
+    return cache_dir_ + "/" + cv::format("%016llx", kHash) + ".feat";
+  }
+
+  //@brief Map the cached features of an image, computing and caching them
+  // first if needed.
+  //@param compute Callable returning a std::pair of the [2 x n] keypoints and
+  // the [m x n] descriptors, see WriteFeatureFile. Only called on cache miss.
+  //@return The mapped features, or nullptr if they could be neither read nor
+  // written.
+  template <typename F>
+  std::shared_ptr<const MappedFeatureFile> GetOrCompute(
+      const std::string& image_file, const std::string& params, F&& compute) {
+    const std::string kPath = Path(image_file, params);
+    {
+      auto features = std::make_shared<const MappedFeatureFile>(kPath);
+      if (features->is_open()) return features;
+    }
+
+    const std::pair<cv::Mat, cv::Mat> kFeatures = compute();
+    //! Write to a temporary file first and rename it, which is atomic, such
+    //! that concurrent readers never see a partially written file.
+    std::ostringstream tmp_path;
+    tmp_path << kPath << ".tmp." << std::this_thread::get_id();
+    if (!uzh::WriteFeatureFile(tmp_path.str(), kFeatures.first,
+                               kFeatures.second) ||
+        std::rename(tmp_path.str().c_str(), kPath.c_str()) != 0) {
+      std::remove(tmp_path.str().c_str());
+      return nullptr;
+    }
+    auto features = std::make_shared<const MappedFeatureFile>(kPath);
+    return features->is_open() ? features : nullptr;
+  }
+
+ private:
+  //@brief 64-bit FNV-1a hash.
+  static std::uint64_t Hash(const std::string& s) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char c : s) {
+      hash ^= c;
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  std::string cache_dir_;
+};
+
+}  // namespace uzh
+
+#endif  // UZH_IO_FEATURE_CACHE_H_
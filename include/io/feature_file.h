@@ -0,0 +1,229 @@
+#ifndef UZH_IO_FEATURE_FILE_H_
+#define UZH_IO_FEATURE_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "glog/logging.h"
+#include "opencv2/core.hpp"
+
+namespace uzh {
+
+//! Binary feature file layout, all numbers in the native byte order:
+//! - FeatureFileHeader, 64 bytes;
+//! - keypoints as SoA: num_keypoints int32 rows followed by num_keypoints int32
+//!   cols, i.e. the [2 x n] CV_32S keypoints matrix used throughout;
+//! - descriptors as a [descriptor_dim x n] matrix, i.e. the layout taken by
+//!   MatchDescriptors, of uint8 or float32. The array and each of its rows
+//!   start at a multiple of 64 bytes, such that SIMD loads are aligned.
+//! Memory-mapping the file yields cv::Mat headers over both arrays with no
+//! parsing or copying, hence the bytes are not swapped. A file written on a
+//! host of the other byte order reads a byte-swapped version, which never
+//! equals kFeatureFileVersion, hence it is rejected and recomputed by
+//! FeatureCache.
+
+enum FeatureDescriptorType : int { DESCRIPTOR_UINT8, DESCRIPTOR_FLOAT32 };
+
+constexpr std::size_t kFeatureFileAlignment = 64;
+
+struct FeatureFileHeader {
+  char magic[8];  // "UZHFEAT" followed by '\0'.
+  std::uint32_t version;
+  std::uint32_t descriptor_type;  // FeatureDescriptorType
+  std::uint32_t num_keypoints;
+  std::uint32_t descriptor_dim;
+  std::uint64_t keypoints_offset;    // In bytes from the file start.
+  std::uint64_t descriptors_offset;  // In bytes, multiple of 64.
+  std::uint64_t descriptors_step;    // Bytes per row, multiple of 64.
+  char reserved[16];
+};
+static_assert(sizeof(FeatureFileHeader) == kFeatureFileAlignment,
+              "FeatureFileHeader must be 64 bytes.");
+
+constexpr char kFeatureFileMagic[8] = "UZHFEAT";
+constexpr std::uint32_t kFeatureFileVersion = 1;
+static_assert(kFeatureFileVersion !=
+                  ((kFeatureFileVersion & 0xff) << 24 |
+                   (kFeatureFileVersion & 0xff00) << 8 |
+                   (kFeatureFileVersion >> 8 & 0xff00) |
+                   kFeatureFileVersion >> 24),
+              "The version must differ from its byte swap to detect files "
+              "of the other byte order.");
+
+inline std::uint64_t AlignFeatureFileOffset(const std::uint64_t offset) {
+  return (offset + kFeatureFileAlignment - 1) / kFeatureFileAlignment *
+         kFeatureFileAlignment;
+}
+
+namespace internal {
+
+//@brief Whether num_elements elements of elem_size bytes starting at offset
+// lie within a file of file_size bytes, computed without overflow.
+inline bool FeatureFileRegionFits(const std::uint64_t offset,
+                                  const std::uint64_t num_elements,
+                                  const std::uint64_t elem_size,
+                                  const std::uint64_t file_size) {
+  if (offset > file_size) return false;
+  return elem_size == 0 || num_elements <= (file_size - offset) / elem_size;
+}
+
+}  // namespace internal
+
+//@brief Write keypoints and descriptors to a binary feature file.
+//@param file_name Path of the file to be written.
+//@param keypoints [2 x n] matrix where each column contains the (row, col)
+// coordinates of a keypoint. It is converted to CV_32S.
+//@param descriptors [m x n] matrix where each column is a descriptor. CV_8U is
+// stored as uint8 and the other depths as float32.
+//@return False if the file could not be written.
+bool WriteFeatureFile(const std::string& file_name, const cv::Mat& keypoints,
+                      const cv::Mat& descriptors) {
+  if (keypoints.rows != 2) LOG(ERROR) << "keypoints is a [2 x n] matrix.";
+  if (descriptors.cols != keypoints.cols || descriptors.channels() != 1)
+    LOG(ERROR) << "descriptors must be a single channel [m x n] matrix.";
+
+  cv::Mat kpts, descs;
+  keypoints.convertTo(kpts, CV_32S);
+  const bool is_uint8 = descriptors.depth() == CV_8U;
+  descriptors.convertTo(descs, is_uint8 ? CV_8U : CV_32F);
+
+  FeatureFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kFeatureFileMagic, sizeof(header.magic));
+  header.version = kFeatureFileVersion;
+  header.descriptor_type = is_uint8 ? DESCRIPTOR_UINT8 : DESCRIPTOR_FLOAT32;
+  header.num_keypoints = static_cast<std::uint32_t>(kpts.cols);
+  header.descriptor_dim = static_cast<std::uint32_t>(descs.rows);
+  header.keypoints_offset = sizeof(FeatureFileHeader);
+  const std::uint64_t kKeypointsBytes = kpts.total() * kpts.elemSize();
+  header.descriptors_offset =
+      AlignFeatureFileOffset(header.keypoints_offset + kKeypointsBytes);
+  header.descriptors_step =
+      AlignFeatureFileOffset(static_cast<std::uint64_t>(descs.cols) *
+                             descs.elemSize());
+
+  std::FILE* file = std::fopen(file_name.c_str(), "wb");
+  if (file == nullptr) {
+    LOG(ERROR) << "Cannot open " << file_name << " for writing.";
+    return false;
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  ok = ok &&
+       std::fwrite(kpts.data, 1, kKeypointsBytes, file) == kKeypointsBytes;
+  // Zero padding up to the aligned offsets.
+  const char kZeros[kFeatureFileAlignment] = {};
+  const std::size_t kPadding =
+      header.descriptors_offset - header.keypoints_offset - kKeypointsBytes;
+  ok = ok && std::fwrite(kZeros, 1, kPadding, file) == kPadding;
+  const std::size_t kRowBytes = descs.cols * descs.elemSize();
+  for (int r = 0; r < descs.rows && ok; ++r) {
+    ok = std::fwrite(descs.ptr(r), 1, kRowBytes, file) == kRowBytes &&
+         std::fwrite(kZeros, 1, header.descriptors_step - kRowBytes, file) ==
+             header.descriptors_step - kRowBytes;
+  }
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok) LOG(ERROR) << "Failed to write " << file_name;
+  return ok;
+}
+
+//@brief Read-only memory mapping of a feature file written by
+// WriteFeatureFile.
+//! keypoints() and descriptors() are cv::Mat headers over the mapping, which
+//! stay valid as long as the MappedFeatureFile is alive. They must not be
+//! written to.
+class MappedFeatureFile {
+ public:
+  explicit MappedFeatureFile(const std::string& file_name) {
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 &&
+        st.st_size >= static_cast<off_t>(sizeof(FeatureFileHeader))) {
+      size_ = static_cast<std::size_t>(st.st_size);
+      void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) data_ = static_cast<unsigned char*>(data);
+    }
+    //! The mapping outlives the descriptor.
+    ::close(fd);
+    if (data_ == nullptr) return;
+
+    //! Every field is checked before a region is exposed, such that a
+    //! truncated or corrupt file is rejected, and recomputed by FeatureCache,
+    //! instead of being read out of the mapping.
+    const FeatureFileHeader& header =
+        *reinterpret_cast<const FeatureFileHeader*>(data_);
+    const int kDepth =
+        header.descriptor_type == DESCRIPTOR_UINT8 ? CV_8U : CV_32F;
+    const std::uint64_t kElemSize = kDepth == CV_8U ? 1 : 4;
+    const std::uint64_t kMaxInt = std::numeric_limits<int>::max();
+    if (std::memcmp(header.magic, kFeatureFileMagic, sizeof(header.magic)) !=
+            0 ||
+        // Also rejects files of the other byte order, see above.
+        header.version != kFeatureFileVersion ||
+        (header.descriptor_type != DESCRIPTOR_UINT8 &&
+         header.descriptor_type != DESCRIPTOR_FLOAT32) ||
+        header.num_keypoints > kMaxInt || header.descriptor_dim > kMaxInt ||
+        header.keypoints_offset < sizeof(FeatureFileHeader) ||
+        header.keypoints_offset % sizeof(std::int32_t) != 0 ||
+        !internal::FeatureFileRegionFits(header.keypoints_offset,
+                                         2ull * header.num_keypoints,
+                                         sizeof(std::int32_t), size_) ||
+        header.descriptors_offset % kFeatureFileAlignment != 0 ||
+        header.descriptors_step % kFeatureFileAlignment != 0 ||
+        header.descriptors_step < header.num_keypoints * kElemSize ||
+        !internal::FeatureFileRegionFits(header.descriptors_offset,
+                                         header.descriptor_dim,
+                                         header.descriptors_step, size_)) {
+      LOG(ERROR) << file_name << " is not a valid feature file.";
+      Unmap();
+      return;
+    }
+
+    const int kNumKeypoints = static_cast<int>(header.num_keypoints);
+    keypoints_ = cv::Mat(2, kNumKeypoints, CV_32S,
+                         data_ + header.keypoints_offset);
+    descriptors_ = cv::Mat(static_cast<int>(header.descriptor_dim),
+                           kNumKeypoints, kDepth,
+                           data_ + header.descriptors_offset,
+                           header.descriptors_step);
+  }
+
+  MappedFeatureFile(const MappedFeatureFile&) = delete;
+  MappedFeatureFile& operator=(const MappedFeatureFile&) = delete;
+
+  ~MappedFeatureFile() { Unmap(); }
+
+  bool is_open() const { return data_ != nullptr; }
+
+  //@brief [2 x n] CV_32S matrix of the (row, col) coordinates.
+  const cv::Mat& keypoints() const { return keypoints_; }
+
+  //@brief [m x n] CV_8U or CV_32F matrix where each column is a descriptor.
+  const cv::Mat& descriptors() const { return descriptors_; }
+
+ private:
+  void Unmap() {
+    keypoints_.release();
+    descriptors_.release();
+    if (data_ != nullptr) ::munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  unsigned char* data_ = nullptr;
+  std::size_t size_ = 0;
+  cv::Mat keypoints_;
+  cv::Mat descriptors_;
+};
+
+}  // namespace uzh
+
+#endif  // UZH_IO_FEATURE_FILE_H_
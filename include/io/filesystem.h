@@ -0,0 +1,20 @@
+#ifndef UZH_IO_FILESYSTEM_H_
+#define UZH_IO_FILESYSTEM_H_
+
+//! std::filesystem is only shipped from g++ 8 on, hence g++ 7 falls back to
+//! std::experimental::filesystem. Both need stdc++fs before g++ 9, which is
+//! linked through FILESYSTEM_LIBRARIES, see the top-level CMakeLists.txt.
+//! Only the functions common to both are to be used through uzh::fs.
+#if __has_include(<filesystem>)
+#include <filesystem>
+namespace uzh {
+namespace fs = std::filesystem;
+}  // namespace uzh
+#else
+#include <experimental/filesystem>
+namespace uzh {
+namespace fs = std::experimental::filesystem;
+}  // namespace uzh
+#endif
+
+#endif  // UZH_IO_FILESYSTEM_H_
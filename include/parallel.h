@@ -0,0 +1,7 @@
+#ifndef UZH_PARALLEL_H_
+#define UZH_PARALLEL_H_
+
+#include "parallel/simd_ops.h"
+#include "parallel/thread_pool.h"
+
+#endif  // UZH_PARALLEL_H_
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef UZH_PARALLEL_SIMD_OPS_H_
+#define UZH_PARALLEL_SIMD_OPS_H_
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace uzh {
+
+namespace internal {
+
+//@brief Arithmetic on scalars of type T, against which SIMD kernels are
+// written once and instantiated for scalars and, with AVX2, for vectors, see
+// Avx2Ops. kWidth is the number of lanes of V.
+template <typename T>
+struct ScalarOps {
+  using V = T;
+  static constexpr int kWidth = 1;
+  static V Set(const double a) { return static_cast<T>(a); }
+  static V Load(const T* p) { return *p; }
+  static void Store(T* p, const V a) { *p = a; }
+  static V Add(const V a, const V b) { return a + b; }
+  static V Sub(const V a, const V b) { return a - b; }
+  static V Mul(const V a, const V b) { return a * b; }
+  static V Div(const V a, const V b) { return a / b; }
+  //! Comparisons with NaN are false, hence NaN residuals are never inliers.
+  static int CountLess(const V a, const V b) { return a < b; }
+};
+
+#if defined(__AVX2__)
+//@brief Arithmetic on 4 doubles or 8 floats with AVX2.
+template <typename T>
+struct Avx2Ops;
+
+template <>
+struct Avx2Ops<double> {
+  using V = __m256d;
+  static constexpr int kWidth = 4;
+  static V Set(const double a) { return _mm256_set1_pd(a); }
+  static V Load(const double* p) { return _mm256_loadu_pd(p); }
+  static void Store(double* p, const V a) { _mm256_storeu_pd(p, a); }
+  static V Add(const V a, const V b) { return _mm256_add_pd(a, b); }
+  static V Sub(const V a, const V b) { return _mm256_sub_pd(a, b); }
+  static V Mul(const V a, const V b) { return _mm256_mul_pd(a, b); }
+  static V Div(const V a, const V b) { return _mm256_div_pd(a, b); }
+  static int CountLess(const V a, const V b) {
+    return __builtin_popcount(
+        _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)));
+  }
+};
+
+template <>
+struct Avx2Ops<float> {
+  using V = __m256;
+  static constexpr int kWidth = 8;
+  static V Set(const double a) {
+    return _mm256_set1_ps(static_cast<float>(a));
+  }
+  static V Load(const float* p) { return _mm256_loadu_ps(p); }
+  static void Store(float* p, const V a) { _mm256_storeu_ps(p, a); }
+  static V Add(const V a, const V b) { return _mm256_add_ps(a, b); }
+  static V Sub(const V a, const V b) { return _mm256_sub_ps(a, b); }
+  static V Mul(const V a, const V b) { return _mm256_mul_ps(a, b); }
+  static V Div(const V a, const V b) { return _mm256_div_ps(a, b); }
+  static int CountLess(const V a, const V b) {
+    return __builtin_popcount(
+        _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)));
+  }
+};
+#endif
+
+}  // namespace internal
+
+}  // namespace uzh
+
+#endif  // UZH_PARALLEL_SIMD_OPS_H_
@@ -0,0 +1,213 @@
+#ifndef UZH_PARALLEL_THREAD_POOL_H_
+#define UZH_PARALLEL_THREAD_POOL_H_
+
+#include <algorithm>  // std::max, std::min
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace uzh {
+
+//@brief Work-stealing thread pool.
+//! Each worker owns a task deque. A task submitted from inside a worker is
+//! pushed to the back of that worker's deque and popped LIFO by its owner for
+//! locality, whilst idle workers steal from the front of other deques. Tasks
+//! submitted from outside the pool are distributed round-robin.
+//! Threads that wait on the pool, i.e. ParallelFor and Wait, keep executing
+//! pending tasks instead of blocking, hence nested parallelism, e.g. a task
+//! which itself calls ParallelFor, never deadlocks.
+class ThreadPool {
+ public:
+  //@brief Spawn num_threads workers. If num_threads <= 0, the number of
+  // hardware threads is used.
+  explicit ThreadPool(int num_threads = 0) {
+    if (num_threads <= 0)
+      num_threads =
+          std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    queues_.reserve(num_threads);
+    for (int i = 0; i < num_threads; ++i)
+      queues_.push_back(std::make_unique<TaskQueue>());
+    workers_.reserve(num_threads);
+    for (int i = 0; i < num_threads; ++i)
+      workers_.emplace_back([this, i] { WorkerLoop(i); });
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (std::thread& worker : workers_) worker.join();
+  }
+
+  //@brief Shared pool with one worker per hardware thread.
+  static ThreadPool& Global() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  int size() const { return static_cast<int>(workers_.size()); }
+
+  //@brief Submit a callable and return a future of its result.
+  template <typename F>
+  std::future<std::invoke_result_t<std::decay_t<F>>> Submit(F&& f) {
+    using R = std::invoke_result_t<std::decay_t<F>>;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> future = task->get_future();
+    Push([task] { (*task)(); });
+    return future;
+  }
+
+  //@brief Block until the future is ready while helping with pending tasks.
+  template <typename T>
+  T Wait(std::future<T>& future) {
+    while (future.wait_for(std::chrono::seconds(0)) !=
+           std::future_status::ready) {
+      if (!RunPendingTask()) std::this_thread::yield();
+    }
+    return future.get();
+  }
+
+  //@brief Evaluate f(i) for i = begin, ..., end - 1 in parallel and return once
+  // all of them are done. The calling thread participates in the work.
+  //! If f throws, the rest of the chunk is skipped, all chunks are still
+  //! waited for, and the first exception is rethrown to the caller.
+  //@param grain_size Number of consecutive indices processed by one task. If
+  // grain_size <= 0, the range is split into about four tasks per worker.
+  template <typename F>
+  void ParallelFor(const int begin, const int end, F&& f,
+                   int grain_size = 0) {
+    if (end <= begin) return;
+    const int kNumIndices = end - begin;
+    if (grain_size <= 0)
+      grain_size = std::max(1, kNumIndices / (4 * size()));
+    const int kNumChunks = (kNumIndices + grain_size - 1) / grain_size;
+
+    std::atomic<int> num_remaining(kNumChunks);
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+    for (int c = 0; c < kNumChunks; ++c) {
+      const int first = begin + c * grain_size;
+      const int last = std::min(end, first + grain_size);
+      Push([&f, &num_remaining, &exception, &exception_mutex, first, last] {
+        try {
+          for (int i = first; i < last; ++i) f(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(exception_mutex);
+          if (!exception) exception = std::current_exception();
+        }
+        // Always count the chunk as done, otherwise the caller waits forever.
+        num_remaining.fetch_sub(1, std::memory_order_release);
+      });
+    }
+    //! The chunks refer to f and the locals above, hence the caller only leaves
+    //! once all of them are done. No task run meanwhile throws, as the chunks
+    //! catch and Submit stores the exceptions in the futures.
+    while (num_remaining.load(std::memory_order_acquire) > 0) {
+      if (!RunPendingTask()) std::this_thread::yield();
+    }
+    if (exception) std::rethrow_exception(exception);
+  }
+
+  //@brief Pop and run one pending task, if any.
+  //@return True if a task was run.
+  bool RunPendingTask() {
+    std::function<void()> task;
+    const int start = current_pool_ == this ? current_index_ : 0;
+    if (!Pop(start, &task)) return false;
+    task();
+    return true;
+  }
+
+ private:
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void Push(std::function<void()> task) {
+    const int kNumQueues = static_cast<int>(queues_.size());
+    const int index =
+        current_pool_ == this
+            ? current_index_
+            : static_cast<int>(next_queue_.fetch_add(
+                                   1, std::memory_order_relaxed) %
+                               kNumQueues);
+    {
+      std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+      queues_[index]->tasks.push_back(std::move(task));
+    }
+    num_pending_.fetch_add(1, std::memory_order_release);
+    // Lock-then-notify such that a worker checking the predicate can not miss
+    // the new task.
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    sleep_cv_.notify_one();
+  }
+
+  //! The owner pops from the back of its deque and thieves take from the front.
+  bool Pop(const int start, std::function<void()>* task) {
+    const int kNumQueues = static_cast<int>(queues_.size());
+    for (int k = 0; k < kNumQueues; ++k) {
+      TaskQueue& queue = *queues_[(start + k) % kNumQueues];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty()) continue;
+      if (k == 0) {
+        *task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      } else {
+        *task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+      num_pending_.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+    return false;
+  }
+
+  void WorkerLoop(const int index) {
+    current_pool_ = this;
+    current_index_ = index;
+    while (true) {
+      std::function<void()> task;
+      if (Pop(index, &task)) {
+        task();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      sleep_cv_.wait(lock, [this] {
+        return stop_ || num_pending_.load(std::memory_order_acquire) > 0;
+      });
+      if (stop_ && num_pending_.load(std::memory_order_acquire) == 0) return;
+    }
+  }
+
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<int> num_pending_{0};
+  std::atomic<unsigned> next_queue_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  bool stop_ = false;
+
+  // The pool and the queue index the calling thread works for, if any.
+  inline static thread_local const ThreadPool* current_pool_ = nullptr;
+  inline static thread_local int current_index_ = 0;
+};
+
+}  // namespace uzh
+
+#endif  // UZH_PARALLEL_THREAD_POOL_H_
@@ -2,7 +2,11 @@
 #define UZH_RANSAC_H_
 
 #include "ransac/kneip_p3p.h"
+#include "ransac/localization_scoring.h"
 #include "ransac/parabola_ransac.h"
+#include "ransac/parallel_ransac_localization.h"
+#include "ransac/prosac_sampler.h"
 #include "ransac/ransac_localization.h"
+#include "ransac/sprt.h"
 
 #endif  // UZH_RANSAC_H_
\ No newline at end of file
@@ -0,0 +1,422 @@
+#ifndef UZH_RANSAC_LOCALIZATION_SCORING_H_
+#define UZH_RANSAC_LOCALIZATION_SCORING_H_
+
+#include <algorithm>  // std::min, std::shuffle
+#include <cstdint>
+#include <numeric>    // std::iota
+#include <random>
+#include <vector>
+
+#include "Eigen/Core"
+#include "Eigen/LU"
+#include "armadillo"
+#include "dlt/estimate_pose_dlt.h"
+#include "parallel/simd_ops.h"
+#include "ransac/kneip_p3p.h"
+#include "ransac/sprt.h"
+
+namespace uzh {
+
+enum MethodToFindCameraPose : int { DLT, P3P };
+
+//@brief 3D-2D correspondences stored as structure of arrays, packed once
+// before the hypothesis loop of RANSACLocalization.
+struct LocalizationCorrespondences {
+  // Keypoints expressed in pixels, such that p = (u, v).
+  std::vector<double> u, v;
+  // Corresponding landmarks in the world frame.
+  std::vector<double> X, Y, Z;
+  // Unit bearing vectors of the keypoints, i.e. K^-1 * (u, v, 1) normalized.
+  std::vector<double> bx, by, bz;
+
+  int size() const { return static_cast<int>(u.size()); }
+};
+
+//@brief Pack keypoints and landmarks into LocalizationCorrespondences.
+//@param keypoints_flipped [2 x n] matrix of the keypoints as (u, v).
+//@param landmarks [3 x n] matrix of the corresponding landmarks.
+//@param K Calibration matrix.
+LocalizationCorrespondences PackLocalizationCorrespondences(
+    const arma::umat& keypoints_flipped, const arma::mat& landmarks,
+    const Eigen::Matrix3d& K) {
+  const int kNumCorrespondences = keypoints_flipped.n_cols;
+  const Eigen::Matrix3d K_inv = K.inverse();
+  LocalizationCorrespondences correspondences;
+  for (std::vector<double>* coordinates :
+       {&correspondences.u, &correspondences.v, &correspondences.X,
+        &correspondences.Y, &correspondences.Z, &correspondences.bx,
+        &correspondences.by, &correspondences.bz})
+    coordinates->resize(kNumCorrespondences);
+  for (int i = 0; i < kNumCorrespondences; ++i) {
+    const double u = keypoints_flipped(0, i), v = keypoints_flipped(1, i);
+    const Eigen::Vector3d kBearing =
+        (K_inv * Eigen::Vector3d(u, v, 1.0)).normalized();
+    correspondences.u[i] = u;
+    correspondences.v[i] = v;
+    correspondences.X[i] = landmarks(0, i);
+    correspondences.Y[i] = landmarks(1, i);
+    correspondences.Z[i] = landmarks(2, i);
+    correspondences.bx[i] = kBearing(0);
+    correspondences.by[i] = kBearing(1);
+    correspondences.bz[i] = kBearing(2);
+  }
+  return correspondences;
+}
+
+//@brief Coefficients of the projection of landmarks P with the pose [R|t] and
+// the calibration matrix K, following ProjectPoints without distortion, i.e.
+// u = (a * P) / (c * P) + K(0, 2) and v = (b * P) / (c * P) + K(1, 2), where
+// a = K(0, 0) * m_0 + K(0, 1) * m_1, b = K(1, 0) * m_0 + K(1, 1) * m_1 and
+// c = m_2 with m_r the r-th row of [R|t].
+struct ReprojectionCoefficients {
+  double a[4], b[4], c[4], u0, v0;
+
+  ReprojectionCoefficients(const Eigen::Matrix3d& R, const Eigen::Vector3d& t,
+                           const Eigen::Matrix3d& K)
+      : u0(K(0, 2)), v0(K(1, 2)) {
+    for (int j = 0; j < 4; ++j) {
+      const double m0 = j < 3 ? R(0, j) : t(0);
+      const double m1 = j < 3 ? R(1, j) : t(1);
+      a[j] = K(0, 0) * m0 + K(0, 1) * m1;
+      b[j] = K(1, 0) * m0 + K(1, 1) * m1;
+      c[j] = j < 3 ? R(2, j) : t(2);
+    }
+  }
+};
+
+namespace internal {
+
+//@brief ReprojectionCoefficients broadcast to the lanes of Ops::V.
+template <typename Ops>
+struct BroadcastReprojectionCoefficients {
+  typename Ops::V a[4], b[4], c[4], u0, v0;
+
+  explicit BroadcastReprojectionCoefficients(
+      const ReprojectionCoefficients& C)
+      : u0(Ops::Set(C.u0)), v0(Ops::Set(C.v0)) {
+    for (int j = 0; j < 4; ++j) {
+      a[j] = Ops::Set(C.a[j]);
+      b[j] = Ops::Set(C.b[j]);
+      c[j] = Ops::Set(C.c[j]);
+    }
+  }
+};
+
+//@brief Squared reprojection error of the correspondences in the lanes of X,
+// Y, Z, u and v, where the landmarks are transformed, projected and compared
+// without leaving the registers.
+template <typename Ops>
+inline typename Ops::V SquaredReprojectionError(
+    const BroadcastReprojectionCoefficients<Ops>& C, const typename Ops::V X,
+    const typename Ops::V Y, const typename Ops::V Z, const typename Ops::V u,
+    const typename Ops::V v) {
+  using V = typename Ops::V;
+  const auto dot = [&](const V* m) {
+    return Ops::Add(Ops::Add(Ops::Mul(m[0], X), Ops::Mul(m[1], Y)),
+                    Ops::Add(Ops::Mul(m[2], Z), m[3]));
+  };
+  const V kInvDepth = Ops::Div(Ops::Set(1.0), dot(C.c));
+  const V kErrorU =
+      Ops::Sub(Ops::Add(Ops::Mul(dot(C.a), kInvDepth), C.u0), u);
+  const V kErrorV =
+      Ops::Sub(Ops::Add(Ops::Mul(dot(C.b), kInvDepth), C.v0), v);
+  return Ops::Add(Ops::Mul(kErrorU, kErrorU), Ops::Mul(kErrorV, kErrorV));
+}
+
+//@brief Count the correspondences [first, last) whose squared reprojection
+// error is below squared_tolerance with Ops.
+//@return The index of the first correspondence not processed.
+template <typename Ops>
+inline int CountReprojectionInliers(
+    const ReprojectionCoefficients& C,
+    const LocalizationCorrespondences& correspondences, int first,
+    const int last, const double squared_tolerance, int* num_inliers) {
+  const BroadcastReprojectionCoefficients<Ops> kC(C);
+  const typename Ops::V kTolerance = Ops::Set(squared_tolerance);
+  const double *X = correspondences.X.data(), *Y = correspondences.Y.data(),
+               *Z = correspondences.Z.data(), *u = correspondences.u.data(),
+               *v = correspondences.v.data();
+  int count = 0;
+  for (; first + Ops::kWidth <= last; first += Ops::kWidth) {
+    count += Ops::CountLess(
+        SquaredReprojectionError<Ops>(kC, Ops::Load(X + first),
+                                      Ops::Load(Y + first),
+                                      Ops::Load(Z + first),
+                                      Ops::Load(u + first),
+                                      Ops::Load(v + first)),
+        kTolerance);
+  }
+  *num_inliers += count;
+  return first;
+}
+
+//@brief SplitMix64 random number generator, satisfying
+// UniformRandomBitGenerator.
+//! The state is a single word, hence seeding one generator per hypothesis
+//! costs nothing, unlike the 624 words of std::mt19937. Each output is the
+//! state, advanced by a fixed odd increment, passed through a bijective
+//! mixing function, such that the streams of distinct seeds are
+//! statistically independent.
+class SplitMix64 {
+ public:
+  using result_type = std::uint64_t;
+
+  explicit SplitMix64(const std::uint64_t seed) : state_(seed) {}
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~result_type(0); }
+
+  result_type operator()() {
+    std::uint64_t z = (state_ += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+ private:
+  std::uint64_t state_;
+};
+
+//@brief Draw num_samples distinct indices out of [0, n) from generator.
+//! The samples are small enough for Armadillo to keep them on the stack.
+//@param generator UniformRandomBitGenerator, e.g. std::mt19937 or SplitMix64.
+template <typename Generator>
+inline arma::uvec SampleDistinctIndices(const int num_samples, const int n,
+                                        Generator* generator) {
+  std::uniform_int_distribution<int> distribution(0, n - 1);
+  arma::uvec sample(num_samples);
+  for (int k = 0; k < num_samples; ++k) {
+    int i;
+    do {
+      i = distribution(*generator);
+    } while (arma::any(sample.head(k) == static_cast<arma::uword>(i)));
+    sample(k) = i;
+  }
+  return sample;
+}
+
+//@brief Count the correspondences [first, last), with AVX2 if available and
+// the remainder by scalar code.
+inline void CountReprojectionInliersInRange(
+    const ReprojectionCoefficients& C,
+    const LocalizationCorrespondences& correspondences, int first,
+    const int last, const double squared_tolerance, int* num_inliers) {
+#if defined(__AVX2__)
+  first = CountReprojectionInliers<Avx2Ops<double>>(
+      C, correspondences, first, last, squared_tolerance, num_inliers);
+#endif
+  CountReprojectionInliers<ScalarOps<double>>(
+      C, correspondences, first, last, squared_tolerance, num_inliers);
+}
+
+}  // namespace internal
+
+//@brief Number of correspondences whose squared reprojection error with the
+// pose [R_C_W|t_C_W] is below squared_tolerance.
+//! With AVX2, 4 correspondences are transformed, projected and thresholded at
+//! a time and the remainder by scalar code, which is also the fallback without
+//! AVX2. Only the count is kept, hence nothing is written to memory.
+int CountReprojectionInliers(const Eigen::Matrix3d& R_C_W,
+                             const Eigen::Vector3d& t_C_W,
+                             const Eigen::Matrix3d& K,
+                             const LocalizationCorrespondences& correspondences,
+                             const double squared_tolerance) {
+  const ReprojectionCoefficients kC(R_C_W, t_C_W, K);
+  int num_inliers = 0;
+  internal::CountReprojectionInliersInRange(kC, correspondences, 0,
+                                            correspondences.size(),
+                                            squared_tolerance, &num_inliers);
+  return num_inliers;
+}
+
+//@brief Inlier mask of the pose [R_C_W|t_C_W], see CountReprojectionInliers.
+//@return inlier_mask -- [1 x n] row vector where each entry is 1 if the
+// squared reprojection error of the corresponding match is below
+// squared_tolerance and 0 otherwise.
+arma::urowvec /* inlier_mask */
+ReprojectionInlierMask(const Eigen::Matrix3d& R_C_W,
+                       const Eigen::Vector3d& t_C_W, const Eigen::Matrix3d& K,
+                       const LocalizationCorrespondences& correspondences,
+                       const double squared_tolerance) {
+  using Ops = internal::ScalarOps<double>;
+  const internal::BroadcastReprojectionCoefficients<Ops> kC(
+      ReprojectionCoefficients(R_C_W, t_C_W, K));
+  arma::urowvec inlier_mask(correspondences.size());
+  for (int i = 0; i < correspondences.size(); ++i) {
+    inlier_mask(i) = Ops::CountLess(
+        internal::SquaredReprojectionError<Ops>(
+            kC, correspondences.X[i], correspondences.Y[i],
+            correspondences.Z[i], correspondences.u[i], correspondences.v[i]),
+        squared_tolerance);
+  }
+  return inlier_mask;
+}
+
+// Time of computing the poses of a sample with P3P and DLT, in units of the
+// time of verifying one correspondence, as measured roughly.
+constexpr double kSprtModelTimeP3P = 1000.0;
+constexpr double kSprtModelTimeDLT = 10000.0;
+// Number of correspondences verified between two decisions of SPRT, such that
+// they are verified with SIMD as well.
+constexpr int kSprtBlockSize = 16;
+
+//@brief Randomized verification of localization hypotheses with SPRT.
+struct LocalizationSPRT {
+  //@param method Method to find the camera pose, DLT or P3P.
+  //@param keypoints_flipped [2 x n] matrix of the keypoints as (u, v).
+  //@param landmarks [3 x n] matrix of the corresponding landmarks.
+  //@param K Calibration matrix.
+  //@param epsilon Initial inlier ratio.
+  //@param seed Seed of the random order of the correspondences.
+  LocalizationSPRT(const int method, const arma::umat& keypoints_flipped,
+                   const arma::mat& landmarks, const Eigen::Matrix3d& K,
+                   const double epsilon, const unsigned seed)
+      : test(method == uzh::P3P ? kSprtModelTimeP3P : kSprtModelTimeDLT,
+             method == uzh::P3P ? 4 : 1, epsilon),
+        generator(seed) {
+    std::vector<arma::uword> order(keypoints_flipped.n_cols);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), generator);
+    const arma::uvec kOrder(order);
+    correspondences = uzh::PackLocalizationCorrespondences(
+        keypoints_flipped.cols(kOrder), landmarks.cols(kOrder), K);
+  }
+
+  uzh::SPRT test;
+  // Correspondences in random order, each pose being verified from a random
+  // start.
+  LocalizationCorrespondences correspondences;
+  std::mt19937 generator;
+};
+
+//@brief Verify the pose [R_C_W|t_C_W] with SPRT, see SPRT, and update the test
+// if the pose is rejected.
+//! The correspondences are verified in blocks of kSprtBlockSize, each with
+//! CountReprojectionInliers, hence the pose is rejected at the end of the
+//! block where the likelihood ratio crosses the threshold.
+//@return Number of inliers if the pose is accepted, or -1 if rejected.
+int VerifyReprojectionSPRT(const Eigen::Matrix3d& R_C_W,
+                           const Eigen::Vector3d& t_C_W,
+                           const Eigen::Matrix3d& K,
+                           const double squared_tolerance,
+                           uzh::LocalizationSPRT* sprt) {
+  const ReprojectionCoefficients kC(R_C_W, t_C_W, K);
+  const LocalizationCorrespondences& kCorrespondences = sprt->correspondences;
+  const int n = kCorrespondences.size();
+  const int kStart = std::uniform_int_distribution<int>(0, n - 1)(
+      sprt->generator);
+  double log_lambda = 0;
+  int num_consistent = 0, num_verified = 0;
+  // Verify [start, n) and then [0, start).
+  for (const auto& segment : {std::make_pair(kStart, n),
+                              std::make_pair(0, kStart)}) {
+    for (int first = segment.first; first < segment.second;
+         first += kSprtBlockSize) {
+      const int kLast = std::min(segment.second, first + kSprtBlockSize);
+      int count = 0;
+      internal::CountReprojectionInliersInRange(
+          kC, kCorrespondences, first, kLast, squared_tolerance, &count);
+      num_consistent += count;
+      num_verified += kLast - first;
+      log_lambda += count * sprt->test.log_consistent() +
+                    (kLast - first - count) * sprt->test.log_inconsistent();
+      if (log_lambda > sprt->test.log_decision_threshold()) {
+        sprt->test.Reject(num_consistent, num_verified);
+        return -1;
+      }
+    }
+  }
+  return num_consistent;
+}
+
+//@brief Camera pose computed from a minimal sample and its number of inliers.
+struct LocalizationHypothesis {
+  Eigen::Matrix3d R_C_W = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d t_C_W = Eigen::Vector3d::Zero();
+  int num_inliers = 0;
+};
+
+//@brief Compute the camera poses from a minimal sample of correspondences with
+// P3P or DLT and return the one with the most inliers.
+//! Everything is of fixed size, hence nothing is allocated, and the poses are
+//! scored by CountReprojectionInliers.
+//@param method Method to find the camera pose, DLT or P3P.
+//@param correspondences Correspondences from PackLocalizationCorrespondences.
+//@param K Calibration matrix.
+//@param sample_indices Indices of the sampled correspondences, 3 for P3P and 6
+// for DLT.
+//@param squared_tolerance Squared reprojection error below which a
+// correspondence is an inlier.
+//@param sprt If not nullptr, the poses are verified by
+// VerifyReprojectionSPRT and those rejected are discarded.
+//@return The best pose, or no inliers if the sample is degenerate or all
+// poses are rejected.
+LocalizationHypothesis ScoreLocalizationHypothesis(
+    const int method, const LocalizationCorrespondences& correspondences,
+    const Eigen::Matrix3d& K, const arma::uvec& sample_indices,
+    const double squared_tolerance, uzh::LocalizationSPRT* sprt = nullptr) {
+  const auto count_inliers = [&](const Eigen::Matrix3d& R_C_W,
+                                 const Eigen::Vector3d& t_C_W) {
+    return sprt != nullptr
+               ? uzh::VerifyReprojectionSPRT(R_C_W, t_C_W, K,
+                                             squared_tolerance, sprt)
+               : uzh::CountReprojectionInliers(R_C_W, t_C_W, K,
+                                               correspondences,
+                                               squared_tolerance);
+  };
+  if (sprt != nullptr) sprt->test.AddSample();
+
+  LocalizationHypothesis best;
+  if (method == uzh::P3P) {
+    // P3P requires three unitary bearing vectors.
+    Eigen::Matrix3d bearing_vectors, landmark_samples;
+    for (int k = 0; k < 3; ++k) {
+      const int i = sample_indices(k);
+      bearing_vectors.col(k) << correspondences.bx[i], correspondences.by[i],
+          correspondences.bz[i];
+      landmark_samples.col(k) << correspondences.X[i], correspondences.Y[i],
+          correspondences.Z[i];
+    }
+    Eigen::Matrix<Eigen::Matrix<double, 3, 4>, 4, 1> poses;
+    if (uzh::P3P::computePoses(bearing_vectors, landmark_samples, poses) != 0)
+      return best;
+    for (int i = 0; i < poses.rows(); ++i) {
+      //! P3P returns R_W_C rather than R_C_W.
+      //! R_C_W = R_W_C', where ' denotes transpose.
+      //! t_C_W = -R_W_C' * t_W_C.
+      const Eigen::Matrix3d R_C_W = poses(i).leftCols<3>().transpose();
+      const Eigen::Vector3d t_C_W = -R_C_W * poses(i).col(3);
+      const int kNumInliers = count_inliers(R_C_W, t_C_W);
+      if (kNumInliers < 0) continue;
+      // Get the best pose among all possible poses obtained from P3P.
+      if (i == 0 || kNumInliers > best.num_inliers) {
+        best.R_C_W = R_C_W;
+        best.t_C_W = t_C_W;
+        best.num_inliers = kNumInliers;
+      }
+    }
+  } else {
+    Eigen::Matrix<double, 2, 6> normalized_points;
+    Eigen::Matrix<double, 3, 6> landmark_samples;
+    for (int k = 0; k < 6; ++k) {
+      const int i = sample_indices(k);
+      normalized_points.col(k) << correspondences.bx[i] / correspondences.bz[i],
+          correspondences.by[i] / correspondences.bz[i];
+      landmark_samples.col(k) << correspondences.X[i], correspondences.Y[i],
+          correspondences.Z[i];
+    }
+    uzh::CameraMatrixDLT M_DLT =
+        uzh::EstimateMinimalPoseDLT(normalized_points, landmark_samples, K);
+    M_DLT.DecomposeDLT();
+    const int kNumInliers = count_inliers(M_DLT.getR(), M_DLT.gett());
+    if (kNumInliers < 0) return best;
+    best.R_C_W = M_DLT.getR();
+    best.t_C_W = M_DLT.gett();
+    best.num_inliers = kNumInliers;
+  }
+  return best;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_RANSAC_LOCALIZATION_SCORING_H_
@@ -1,14 +1,56 @@
 #ifndef UZH_RANSAC_PARABOLA_RANSAC_H_
 #define UZH_RANSAC_PARABOLA_RANSAC_H_
 
+#include <algorithm>  // std::max
+#include <cmath>
+#include <optional>
 #include <tuple>
 
 #include "armadillo"
 #include "glog/logging.h"
 #include "matlab_port/datasample.h"
+#include "ransac/sprt.h"
 
 namespace uzh {
 
+// Time of drawing a sample and fitting a parabola, in units of the time of
+// verifying one data point, as measured roughly.
+constexpr double kParabolaSprtModelTime = 200.0;
+// Inlier ratio assumed by SPRT until a model is accepted.
+constexpr double kParabolaSprtInitialInlierRatio = 0.1;
+
+namespace internal {
+
+//@brief Verify the parabola poly_coeffs with SPRT on the data points taken in
+// order from a random start, and update the test if it is rejected.
+//@return False if the parabola is rejected.
+inline bool VerifyParabolaSPRT(const arma::vec& poly_coeffs,
+                               const arma::mat& data, const arma::uvec& order,
+                               const double threshold, uzh::SPRT* test) {
+  const int n = order.n_elem;
+  const int kStart =
+      arma::randi<arma::uvec>(1, arma::distr_param(0, n - 1))(0);
+  double log_lambda = 0;
+  int num_consistent = 0;
+  for (int k = 0; k < n; ++k) {
+    const arma::uword j = order((kStart + k) % n);
+    const double x = data(0, j);
+    const bool kIsConsistent =
+        std::abs((poly_coeffs(0) * x + poly_coeffs(1)) * x + poly_coeffs(2) -
+                 data(1, j)) < threshold;
+    num_consistent += kIsConsistent;
+    log_lambda +=
+        kIsConsistent ? test->log_consistent() : test->log_inconsistent();
+    if (log_lambda > test->log_decision_threshold()) {
+      test->Reject(num_consistent, k + 1);
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace internal
+
 //@brief Fit a parabola with outlier rejection performed by RANSAC.
 //@param data [2 x n] matrix where each column contains a 2D data point (x, y).
 //@param max_noise Inliers in the data are contaminated with noise along y
@@ -16,6 +58,10 @@ namespace uzh {
 // which a data point is selected as an inlier or outlier.
 //@param num_iterations RANSAC proceeds until num_iterations iterations are
 // reached.
+//@param sprt If true, each model is first verified by SPRT on the data points
+// in random order, and those rejected are discarded without computing all of
+// the residuals. As the number of iterations is fixed, the rejected good models
+// are not compensated for.
 //@returns
 // best_polynome_coefficients -- [3 x k] matrix containing all polynome
 // coefficients evaluated by polyfit best ever so far at each iteration
@@ -26,7 +72,7 @@ namespace uzh {
 std::tuple<arma::mat /* best_polynome_coefficients */,
            arma::urowvec /* max_inlier_counts */>
 ParabolaRANSAC(const arma::mat& data, const double max_noise,
-               const int num_iterations = 100) {
+               const int num_iterations = 100, const bool sprt = false) {
   if (data.empty()) LOG(ERROR) << "Empty data.";
   if (max_noise < 0 || num_iterations < 0)
     LOG(ERROR) << "max_noise and num_iterations shall not be negative.";
@@ -39,12 +85,31 @@ ParabolaRANSAC(const arma::mat& data, const double max_noise,
 
   arma::vec3 best_poly_coeffs(arma::fill::zeros);
   int max_inlier_cnt = 0;
+
+  // The data points are verified by SPRT in a fixed random order.
+  std::optional<uzh::SPRT> sprt_test;
+  arma::uvec sprt_order;
+  if (sprt) {
+    sprt_test.emplace(kParabolaSprtModelTime, 1,
+                      kParabolaSprtInitialInlierRatio);
+    sprt_order = arma::randperm<arma::uvec>(data.n_cols);
+  }
   for (int i = 0; i < num_iterations; ++i) {
     // Randomly draw 3 samples without replacement.
     arma::mat samples;
     std::tie(samples, std::ignore) = uzh::datasample<double>(data, 3, 1, false);
     // Fit a model with these samples and get the coefficients of the model.
     arma::vec poly_coeffs = arma::polyfit(samples.row(0), samples.row(1), 2);
+    // Skip the model if rejected by SPRT.
+    if (sprt_test) {
+      sprt_test->AddSample();
+      if (!internal::VerifyParabolaSPRT(poly_coeffs, data, sprt_order,
+                                        max_noise + 1e-5, &*sprt_test)) {
+        best_polynome_coefficients.col(i) = best_poly_coeffs;
+        max_inlier_counts(i) = max_inlier_cnt;
+        continue;
+      }
+    }
     // Compute the residuals.
     const arma::rowvec residuals =
         arma::abs(arma::polyval(poly_coeffs, data.row(0)) - data.row(1));
@@ -56,6 +121,10 @@ ParabolaRANSAC(const arma::mat& data, const double max_noise,
 
     if (inlier_cnt > max_inlier_cnt) {
       max_inlier_cnt = inlier_cnt;
+      if (sprt_test) {
+        sprt_test->UpdateEpsilon(std::max(inlier_cnt / double(data.n_cols),
+                                          kParabolaSprtInitialInlierRatio));
+      }
       // Refine the model if more inliers are obtained.
       if (refine_with_inliers) {
         poly_coeffs = arma::polyfit(data(arma::uvec{0}, inlier_indices),
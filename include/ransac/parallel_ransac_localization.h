@@ -0,0 +1,302 @@
+#ifndef UZH_RANSAC_PARALLEL_RANSAC_LOCALIZATION_H_
+#define UZH_RANSAC_PARALLEL_RANSAC_LOCALIZATION_H_
+
+#include <algorithm>  // std::min, std::max
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "Eigen/Core"
+#include "armadillo"
+#include "glog/logging.h"
+#include "parallel/thread_pool.h"
+#include "ransac/localization_scoring.h"
+#include "ransac/prosac_sampler.h"
+#include "ransac/ransac_localization.h"
+#include "transfer/view.h"
+
+namespace uzh {
+
+namespace internal {
+
+//@brief Number of hypotheses evaluated by RANSACLocalization before it stops,
+// given the number of iterations num_iterations, i.e. the smallest k such that
+// k >= num_iterations - 1.
+inline int NumLocalizationHypotheses(const double num_iterations) {
+  return static_cast<int>(std::max(
+      0.0, std::ceil(std::min(num_iterations - 1,
+                              double(kLocalizationMaxIterations)))));
+}
+
+//@brief Order of the hypotheses of RANSACLocalization, where the hypothesis
+// with more inliers and, among equal numbers, the later one is better.
+inline std::int64_t LocalizationHypothesisKey(const int num_inliers,
+                                              const int index) {
+  return (static_cast<std::int64_t>(num_inliers) << 32) | index;
+}
+
+//@brief Seed of the generator of the hypothesis index in deterministic mode,
+// distinct for each pair of seed and index.
+inline std::uint64_t LocalizationHypothesisSeed(const unsigned seed,
+                                                const int index) {
+  return static_cast<std::uint64_t>(seed) << 32 |
+         static_cast<std::uint32_t>(index);
+}
+
+}  // namespace internal
+
+//@brief Localize camera given 3D-2D point correspondences using DLT or P3P,
+// with the hypotheses generated and scored in parallel, see
+// RANSACLocalization for the parameters and the returned values.
+//! The workers draw the samples with their own generators instead of the
+//! thread-local one of Armadillo.
+//! If deterministic is false, each worker of the pool generates and scores
+//! hypotheses with its own generator seeded by seed and its index, and takes
+//! the index of its next hypothesis from a shared counter. The maximum number
+//! of inliers, packed with the index of the hypothesis, is raised with a
+//! compare-and-swap, and the adapted number of hypotheses is recomputed from
+//! it and lowered the same way, hence the workers never lock. The result
+//! depends on the scheduling.
+//! If deterministic is true, the hypotheses are evaluated in batches, each
+//! drawn from its own SplitMix64 seeded by seed and its index, and merged in
+//! order such that the best inlier mask and the number of hypotheses are
+//! exactly those of RANSACLocalization for these samples. The result only
+//! depends on seed, neither on the number of threads nor on the scheduling.
+//! In both cases, the histories are rebuilt in the order of the indices of the
+//! hypotheses. With quality, the k-th hypothesis is drawn as the (k + 1)-th
+//! sample of ProsacSampler, whatever the worker drawing it.
+//@param deterministic If true, the result is reproducible for a fixed seed.
+//@param seed Seed of the generators.
+//@param pool Thread pool on which the hypotheses are evaluated.
+std::tuple<arma::mat33 /* R_C_W */, arma::vec3 /* t_C_W */,
+           arma::urowvec /* best_inlier_mask */,
+           arma::urowvec /* max_num_inliers_history */,
+           arma::rowvec /* num_iterations_history */>
+ParallelRANSACLocalization(const arma::umat& keypoints,
+                           const arma::mat& landmarks, const arma::mat& K,
+                           const int method = uzh::P3P,
+                           const int adaptive_iterations = true,
+                           const bool tweak_for_more_robust = true,
+                           const arma::rowvec& quality = arma::rowvec(),
+                           const bool deterministic = false,
+                           const unsigned seed = 0,
+                           uzh::ThreadPool& pool = uzh::ThreadPool::Global()) {
+  if (keypoints.empty() || landmarks.empty() || K.empty())
+    LOG(ERROR) << "Empty input.";
+  if (keypoints.n_rows != 2 || landmarks.n_rows != 3 ||
+      arma::size(K) != arma::size(3, 3))
+    LOG(ERROR) << "Invalid input.";
+  if (keypoints.n_cols != landmarks.n_cols) {
+    LOG(ERROR)
+        << "Number of keypoints must be the same with that of landmarks.";
+  }
+  if (method != uzh::P3P && method != uzh::DLT)
+    LOG(ERROR) << "Unsupported method.";
+
+  const int s = uzh::LocalizationSampleSize(method);
+  const int kNumCorrespondences = keypoints.n_cols;
+  if (kNumCorrespondences < s) {
+    LOG(ERROR) << "Insufficient number of correspondences.";
+    return {{}, {}, {}, {}, {}};
+  }
+
+  // Settings as in RANSACLocalization.
+  double num_iterations;
+  if (method == uzh::P3P)
+    num_iterations = tweak_for_more_robust ? 1000 : 200;
+  else
+    num_iterations = 200;
+  if (adaptive_iterations)
+    num_iterations = std::numeric_limits<int>::max();
+  const int min_num_inliers_threshold = tweak_for_more_robust ? 30 : 6;
+
+  // Invariants of the hypothesis loop, shared by the workers.
+  const arma::umat keypoints_flipped = arma::flipud(keypoints);
+  const Eigen::Matrix3d K_eigen = uzh::arma2eigen_view(K);
+  const uzh::LocalizationCorrespondences correspondences =
+      uzh::PackLocalizationCorrespondences(keypoints_flipped, landmarks,
+                                           K_eigen);
+  const double kSquaredTolerance =
+      kLocalizationPixelTolerance * kLocalizationPixelTolerance;
+
+  std::optional<uzh::ProsacSampler> prosac_sampler;
+  if (!quality.empty()) {
+    // Mismatched qualities would rank other correspondences, hence they are
+    // dropped and the samples are drawn uniformly.
+    if (quality.n_elem != kNumCorrespondences)
+      LOG(ERROR) << "Number of qualities must be the same with that of "
+                    "keypoints. Sampling uniformly instead.";
+    else
+      prosac_sampler.emplace(quality, s);
+  }
+
+  // Number of inliers of each hypothesis, or 0 if it does not exceed
+  // min_num_inliers_threshold.
+  std::vector<int> num_inliers(kLocalizationMaxIterations, 0);
+  const auto evaluate_hypothesis = [&](const int index, auto* generator) {
+    const arma::uvec sample_indices =
+        prosac_sampler
+            ? prosac_sampler->Sample(index + 1, generator)
+            : internal::SampleDistinctIndices(s, kNumCorrespondences,
+                                              generator);
+    const uzh::LocalizationHypothesis kHypothesis =
+        uzh::ScoreLocalizationHypothesis(method, correspondences, K_eigen,
+                                         sample_indices, kSquaredTolerance);
+    num_inliers[index] = kHypothesis.num_inliers > min_num_inliers_threshold
+                             ? kHypothesis.num_inliers
+                             : 0;
+    return kHypothesis;
+  };
+
+  // Number of hypotheses evaluated, which are always those with indices
+  // [0, num_hypotheses).
+  int num_hypotheses = 0;
+  uzh::LocalizationHypothesis best_hypothesis;
+  if (deterministic) {
+    const int kBatchSize = 4 * pool.size();
+    std::vector<uzh::LocalizationHypothesis> batch(kBatchSize);
+    int max_num_inliers = 0;
+    bool is_done = false;
+    while (!is_done) {
+      const int kFirst = num_hypotheses;
+      const int kLast =
+          std::min(kFirst + kBatchSize,
+                   internal::NumLocalizationHypotheses(num_iterations));
+      if (kLast <= kFirst) break;
+      pool.ParallelFor(
+          kFirst, kLast,
+          [&](const int index) {
+            //! A generator per hypothesis, such that the result does not
+            //! depend on the worker. SplitMix64 is seeded for free, whereas
+            //! seeding std::mt19937 costs about as much as a hypothesis.
+            internal::SplitMix64 generator(
+                internal::LocalizationHypothesisSeed(seed, index));
+            batch[index - kFirst] = evaluate_hypothesis(index, &generator);
+          },
+          1);
+      // Merge in order, stopping where RANSACLocalization would stop.
+      for (int index = kFirst; index < kLast; ++index) {
+        if (!(index < num_iterations - 1)) {
+          is_done = true;
+          break;
+        }
+        if (num_inliers[index] > 0 && num_inliers[index] >= max_num_inliers) {
+          max_num_inliers = num_inliers[index];
+          best_hypothesis = batch[index - kFirst];
+        }
+        if (adaptive_iterations) {
+          num_iterations = uzh::AdaptiveLocalizationIterations(
+              max_num_inliers, kNumCorrespondences, method);
+        }
+        ++num_hypotheses;
+      }
+    }
+  } else {
+    // The first hypothesis is always evaluated, and the bound computed from
+    // no inliers is the largest adapted bound.
+    const int kInitialNumHypotheses =
+        adaptive_iterations
+            ? std::max(1, internal::NumLocalizationHypotheses(
+                              uzh::AdaptiveLocalizationIterations(
+                                  0, kNumCorrespondences, method)))
+            : internal::NumLocalizationHypotheses(num_iterations);
+    std::atomic<int> next_index{0};
+    std::atomic<std::int64_t> best_key{-1};
+    std::atomic<int> max_num_hypotheses{kInitialNumHypotheses};
+
+    struct WorkerBest {
+      std::int64_t key = -1;
+      uzh::LocalizationHypothesis hypothesis;
+    };
+    std::vector<WorkerBest> worker_bests(pool.size());
+    pool.ParallelFor(
+        0, pool.size(),
+        [&](const int worker) {
+          std::seed_seq seed_sequence{seed, static_cast<unsigned>(worker)};
+          std::mt19937 generator(seed_sequence);
+          WorkerBest& local_best = worker_bests[worker];
+          for (;;) {
+            //! An index is claimed only if it is within the bound, which only
+            //! decreases, hence the claimed indices form a prefix and all of
+            //! them are evaluated.
+            int index = next_index.load();
+            if (index >= max_num_hypotheses.load()) break;
+            if (!next_index.compare_exchange_weak(index, index + 1)) continue;
+            const uzh::LocalizationHypothesis kHypothesis =
+                evaluate_hypothesis(index, &generator);
+            if (num_inliers[index] == 0) continue;
+
+            const std::int64_t kKey = internal::LocalizationHypothesisKey(
+                num_inliers[index], index);
+            if (kKey > local_best.key) {
+              local_best.key = kKey;
+              local_best.hypothesis = kHypothesis;
+            }
+            std::int64_t key = best_key.load();
+            while (kKey > key && !best_key.compare_exchange_weak(key, kKey)) {
+            }
+            if (kKey <= key || !adaptive_iterations) continue;
+
+            // Recompute the bound from the global maximum number of inliers.
+            const int kNumHypotheses = internal::NumLocalizationHypotheses(
+                uzh::AdaptiveLocalizationIterations(
+                    num_inliers[index], kNumCorrespondences, method));
+            int bound = max_num_hypotheses.load();
+            while (kNumHypotheses < bound &&
+                   !max_num_hypotheses.compare_exchange_weak(bound,
+                                                            kNumHypotheses)) {
+            }
+          }
+        },
+        1);
+    num_hypotheses = next_index;
+
+    // The best hypothesis is the best of those of the workers.
+    std::int64_t best = -1;
+    for (const WorkerBest& worker_best : worker_bests) {
+      if (worker_best.key > best) {
+        best = worker_best.key;
+        best_hypothesis = worker_best.hypothesis;
+      }
+    }
+  }
+
+  // Rebuild the histories in the order of the hypotheses.
+  arma::urowvec max_num_inliers_history(num_hypotheses);
+  arma::rowvec num_iterations_history(num_hypotheses);
+  int max_num_inliers = 0;
+  for (int k = 0; k < num_hypotheses; ++k) {
+    max_num_inliers = std::max(max_num_inliers, num_inliers[k]);
+    max_num_inliers_history(k) = max_num_inliers;
+    num_iterations_history(k) =
+        adaptive_iterations ? uzh::AdaptiveLocalizationIterations(
+                                  max_num_inliers, kNumCorrespondences, method)
+                            : num_iterations;
+  }
+
+  // If RANSAC fails, simply return empty objects.
+  if (max_num_inliers == 0) {
+    LOG(INFO) << "No inlier found.";
+    return {{}, {}, {}, {}, {}};
+  }
+  // The inlier mask is only formed for the best hypothesis.
+  const arma::urowvec best_inlier_mask = uzh::ReprojectionInlierMask(
+      best_hypothesis.R_C_W, best_hypothesis.t_C_W, K_eigen, correspondences,
+      kSquaredTolerance);
+  // Refine the pose using DLT with more correspondences as P3P always use 3.
+  arma::mat33 R_C_W;
+  arma::vec3 t_C_W;
+  std::tie(R_C_W, t_C_W) = uzh::RefineLocalizationDLT(
+      keypoints_flipped, landmarks, best_inlier_mask, K);
+  return {R_C_W, t_C_W, best_inlier_mask, max_num_inliers_history,
+          num_iterations_history};
+}
+
+}  // namespace uzh
+
+#endif  // UZH_RANSAC_PARALLEL_RANSAC_LOCALIZATION_H_
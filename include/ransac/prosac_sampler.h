@@ -0,0 +1,123 @@
+#ifndef UZH_RANSAC_PROSAC_SAMPLER_H_
+#define UZH_RANSAC_PROSAC_SAMPLER_H_
+
+#include <algorithm>  // std::stable_sort, std::upper_bound
+#include <cmath>
+#include <numeric>  // std::iota
+#include <random>
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+
+namespace uzh {
+
+// Number of samples T_N after which PROSAC draws from all correspondences,
+// as suggested by Chum and Matas.
+constexpr int kProsacGrowthMaxSamples = 200000;
+
+//@brief Progressive sampler of PROSAC, "Matching with PROSAC - Progressive
+// Sample Consensus" by Chum and Matas, drawing minimal samples from the
+// correspondences of highest quality first and gradually widening the pool
+// until it samples uniformly from all of them.
+//! The t-th sample is drawn from the n(t) best correspondences, where n grows
+//! by one each time t reaches T'_n, the number of samples by which a uniform
+//! sampler would have drawn all subsets of the n best correspondences as many
+//! times, on average, as kProsacGrowthMaxSamples samples draw all subsets of
+//! the N correspondences. Unless all N are in the pool, the sample contains
+//! the n-th best correspondence, such that no subset is drawn twice as often.
+//! The schedule T'_n is precomputed, hence the t-th sample only depends on t
+//! and the generator, and the sampler may be shared by threads drawing samples
+//! in any order.
+class ProsacSampler {
+ public:
+  //@param quality [1 x N] row vector where each entry is the quality of the
+  // corresponding correspondence, the higher the more reliable, e.g. the
+  // negative descriptor distance of the match.
+  //@param sample_size Number of correspondences per sample.
+  ProsacSampler(const arma::rowvec& quality, const int sample_size)
+      : sample_size_(sample_size), sorted_indices_(quality.n_elem) {
+    const int kNumCorrespondences = quality.n_elem;
+    if (kNumCorrespondences < sample_size) {
+      // The schedule is left empty, such that Sample draws nothing.
+      LOG(ERROR) << "Insufficient number of correspondences.";
+      return;
+    }
+
+    // Sort the correspondences by decreasing quality, keeping the order of
+    // equal ones.
+    std::iota(sorted_indices_.begin(), sorted_indices_.end(), 0);
+    std::stable_sort(sorted_indices_.begin(), sorted_indices_.end(),
+                     [&quality](const int a, const int b) {
+                       return quality(a) > quality(b);
+                     });
+
+    // T_n = T_N * C(n, m) / C(N, m), where m is the sample size, and
+    // T'_(n+1) = T'_n + ceil(T_(n+1) - T_n) with T'_m = 1.
+    double T_n = kProsacGrowthMaxSamples;
+    for (int i = 0; i < sample_size; ++i)
+      T_n *= double(sample_size - i) / (kNumCorrespondences - i);
+    int T_prime_n = 1;
+    for (int n = sample_size; n < kNumCorrespondences; ++n) {
+      growth_schedule_.push_back(T_prime_n);
+      const double T_n_plus_1 = T_n * (n + 1) / (n + 1 - sample_size);
+      T_prime_n += static_cast<int>(std::ceil(T_n_plus_1 - T_n));
+      T_n = T_n_plus_1;
+    }
+    growth_schedule_.push_back(T_prime_n);
+  }
+
+  //@brief Size n(t) of the pool from which the t-th sample is drawn.
+  //@param t Index of the sample, starting from 1.
+  int PoolSize(const int t) const {
+    if (growth_schedule_.empty()) return sorted_indices_.size();
+    //! growth_schedule_[k] is T'_(m + k), which is reached at the T'_n-th
+    //! sample and then grows n by one.
+    const int kNumGrowths =
+        std::upper_bound(growth_schedule_.begin(), growth_schedule_.end() - 1,
+                         t) -
+        growth_schedule_.begin();
+    return sample_size_ + kNumGrowths;
+  }
+
+  //@brief Draw the t-th sample.
+  //@param t Index of the sample, starting from 1.
+  //@param generator UniformRandomBitGenerator, e.g. std::mt19937.
+  //@return sample_size distinct indices of the correspondences, or an empty
+  // vector if there are fewer correspondences than sample_size.
+  template <typename Generator>
+  arma::uvec Sample(const int t, Generator* generator) const {
+    if (growth_schedule_.empty()) {
+      LOG(ERROR) << "Insufficient number of correspondences.";
+      return arma::uvec();
+    }
+    const int n = PoolSize(t);
+    // Draw all from the pool once T'_n is exceeded, i.e. n = N. Otherwise,
+    // the n-th best correspondence is included.
+    const bool kIncludeLast = !(growth_schedule_[n - sample_size_] < t);
+    const int kNumDrawn = kIncludeLast ? sample_size_ - 1 : sample_size_;
+    std::uniform_int_distribution<int> distribution(
+        0, kIncludeLast ? n - 2 : n - 1);
+    arma::uvec sample(sample_size_);
+    for (int k = 0; k < kNumDrawn; ++k) {
+      arma::uword i;
+      do {
+        i = sorted_indices_[distribution(*generator)];
+      } while (arma::any(sample.head(k) == i));
+      sample(k) = i;
+    }
+    if (kIncludeLast) sample(sample_size_ - 1) = sorted_indices_[n - 1];
+    return sample;
+  }
+
+ private:
+  int sample_size_;
+  // Indices of the correspondences sorted by decreasing quality.
+  std::vector<int> sorted_indices_;
+  // T'_n for n = m, ..., N, where m is the sample size.
+  std::vector<int> growth_schedule_;
+};
+
+}  // namespace uzh
+
+#endif  // UZH_RANSAC_PROSAC_SAMPLER_H_
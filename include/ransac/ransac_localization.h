@@ -1,8 +1,12 @@
 #ifndef UZH_RANSAC_RANSAC_LOCALIZATION_H_
 #define UZH_RANSAC_RANSAC_LOCALIZATION_H_
 
+#include <algorithm>  // std::min, std::max
 #include <cmath>
+#include <limits>
 #include <numeric>
+#include <optional>
+#include <random>
 #include <tuple>
 #include <vector>
 
@@ -11,13 +15,62 @@
 #include "armadillo"
 #include "dlt/estimate_pose_dlt.h"
 #include "glog/logging.h"
-#include "image_formation/project_points.h"
-#include "matlab_port/nnz.h"
 #include "ransac/kneip_p3p.h"
+#include "ransac/localization_scoring.h"
+#include "ransac/prosac_sampler.h"
+#include "transfer/view.h"
 
 namespace uzh {
 
-enum MethodToFindCameraPose : int { DLT, P3P };
+// Error bound within which a match is selected as inlier.
+constexpr double kLocalizationPixelTolerance = 10.0;
+// Confidence about how much correspondences are inliers.
+constexpr double kLocalizationConfidence = 0.95;
+// Upper bound of the outlier ratio used to adapt the number of iterations.
+constexpr double kLocalizationMaxOutlierRatio = 0.90;
+// Upper bound of the adapted number of iterations.
+constexpr int kLocalizationMaxIterations = 15000;
+
+//@brief Minimum number of correspondences with which the method is able to be
+// performed.
+inline int LocalizationSampleSize(const int method) {
+  return method == uzh::P3P ? 3 : 6;
+}
+
+//@brief Number of iterations adapted to the maximum number of inliers found so
+// far, see RANSACLocalization.
+//@param outlier_ratio If not nullptr, set to the estimated outlier ratio.
+inline double AdaptiveLocalizationIterations(const int max_num_inliers,
+                                             const int num_correspondences,
+                                             const int method,
+                                             double* outlier_ratio = nullptr) {
+  const double kOutlierRatio =
+      std::min(1 - max_num_inliers / double(num_correspondences),
+               kLocalizationMaxOutlierRatio);
+  if (outlier_ratio != nullptr) *outlier_ratio = kOutlierRatio;
+  const double kNumIterations =
+      std::log(1 - kLocalizationConfidence) /
+      std::log(1 - std::pow((1 - kOutlierRatio),
+                            uzh::LocalizationSampleSize(method)));
+  return std::min(kNumIterations, double(kLocalizationMaxIterations));
+}
+
+//@brief Refine the pose using DLT with all inliers, as P3P always uses 3.
+std::tuple<arma::mat33 /* R_C_W */, arma::vec3 /* t_C_W */>
+RefineLocalizationDLT(const arma::umat& keypoints_flipped,
+                      const arma::mat& landmarks,
+                      const arma::urowvec& inlier_mask, const arma::mat& K) {
+  const arma::uvec kInliers = arma::find(inlier_mask);
+  uzh::CameraMatrixDLT M_DLT_final = uzh::EstimatePoseDLT(
+      uzh::arma2eigen(
+          arma::conv_to<arma::mat>::from(keypoints_flipped.cols(kInliers))),
+      uzh::arma2eigen(landmarks.cols(kInliers)), uzh::arma2eigen(K));
+  M_DLT_final.DecomposeDLT();
+  const arma::mat M_C_W_final = uzh::eigen2arma(M_DLT_final.getM());
+  const arma::mat33 R_C_W_final = M_C_W_final.head_cols(3);
+  const arma::vec3 t_C_W_final = M_C_W_final.tail_cols(1);
+  return {R_C_W_final, t_C_W_final};
+}
 
 //@brief Localize camera given 3D-2D point correspondences using DLT or P3P.
 //@param keypoints [2 x n] matrix where each column contains a matched image
@@ -33,6 +86,15 @@ enum MethodToFindCameraPose : int { DLT, P3P };
 // number of inliers, exceed which the inlier mask at each iteration is then
 // possible to be selected as the best inlier mask, are set bigger. By default,
 // it's set to true.
+//@param quality [1 x n] row vector where each entry is the quality of the
+// corresponding match, the higher the more reliable, e.g. the negative
+// descriptor distance. If not empty, the samples are drawn by ProsacSampler
+// from the best matches first, such that a good pose and hence the adaptive
+// termination are reached earlier. Otherwise, they are drawn uniformly.
+//@param sprt If true, each pose is verified by LocalizationSPRT, which rejects
+// most bad poses after a few correspondences in random order instead of
+// scoring all of them. The adapted number of iterations then accounts for the
+// good poses that are rejected as well, see SPRT::AdaptiveIterations.
 //@returns
 //- R_C_W -- [3 x 3] rotation matrix.
 //- t_C_W -- [3 x 1] translation vector. The rigid transformation formed with
@@ -52,7 +114,9 @@ std::tuple<arma::mat33 /* R_C_W */, arma::vec3 /* t_C_W */,
 RANSACLocalization(const arma::umat& keypoints, const arma::mat& landmarks,
                    const arma::mat& K, const int method = uzh::P3P,
                    const int adaptive_iterations = true,
-                   const bool tweak_for_more_robust = true) {
+                   const bool tweak_for_more_robust = true,
+                   const arma::rowvec& quality = arma::rowvec(),
+                   const bool sprt = false) {
   if (keypoints.empty() || landmarks.empty() || K.empty())
     LOG(ERROR) << "Empty input.";
   if (keypoints.n_rows != 2 || landmarks.n_rows != 3 ||
@@ -80,133 +144,100 @@ RANSACLocalization(const arma::umat& keypoints, const arma::mat& landmarks,
 
   // Determine settings according to parameters.
   double num_iterations;
-  int s;  // Minimum number of points with which the corresponding method is
-          // able to be performed.
+  // Minimum number of points with which the corresponding method is able to
+  // be performed.
+  const int s = uzh::LocalizationSampleSize(method);
+  if (kNumCorrespondences < s) {
+    LOG(ERROR) << "Insufficient number of correspondences.";
+    return {{}, {}, {}, {}, {}};
+  }
   if (method == uzh::P3P) {
-    s = 3;
     if (tweak_for_more_robust)
       num_iterations = 1000;
     else
       num_iterations = 200;
   } else {
-    s = 6;
     num_iterations = 200;
   }
   if (adaptive_iterations) {
     // Number of iterations is not fixed if using adaptive iterations.
     num_iterations = std::numeric_limits<int>::max();
   }
-  // Error bound within which a match is selected as inlier.
-  const double kPixelTolerance = 10.0;
+
+  // Invariants of the hypothesis loop, computed once. The hypotheses are
+  // scored on the correspondences packed as structure of arrays, see
+  // ScoreLocalizationHypothesis.
+  const Eigen::Matrix3d K_eigen = uzh::arma2eigen_view(K);
+  const uzh::LocalizationCorrespondences correspondences =
+      uzh::PackLocalizationCorrespondences(keypoints_flipped, landmarks,
+                                           K_eigen);
+  const double kSquaredTolerance =
+      kLocalizationPixelTolerance * kLocalizationPixelTolerance;
+
+  // The samples are drawn from a generator seeded from the thread-local one of
+  // Armadillo such that arma_rng::set_seed still fixes them.
+  std::mt19937 generator(arma::randi<arma::uvec>(
+      1, arma::distr_param(0, std::numeric_limits<int>::max()))(0));
+  std::optional<uzh::ProsacSampler> prosac_sampler;
+  if (!quality.empty()) {
+    // Mismatched qualities would rank other correspondences, hence they are
+    // dropped and the samples are drawn uniformly.
+    if (quality.n_elem != kNumCorrespondences)
+      LOG(ERROR) << "Number of qualities must be the same with that of "
+                    "keypoints. Sampling uniformly instead.";
+    else
+      prosac_sampler.emplace(quality, s);
+  }
+  // The test starts from the lowest inlier ratio considered.
+  std::optional<uzh::LocalizationSPRT> sprt_verifier;
+  if (sprt) {
+    sprt_verifier.emplace(method, keypoints_flipped, landmarks, K_eigen,
+                          1 - kLocalizationMaxOutlierRatio, generator());
+  }
+  uzh::LocalizationHypothesis best_hypothesis;
 
   int k = 0;                 // Iteration counter.
   int max_num_inliers = 0;   // Maximum number of inliers found so far.
   double outlier_ratio = 0;  // Record outlier ratio at each iteration.
   while (k < num_iterations - 1) {
-    arma::mat landmark_samples;
-    arma::uvec sample_indices;
-    std::tie(landmark_samples, sample_indices) =
-        uzh::datasample<double>(landmarks, s, 1, false);
-    const arma::umat corresponding_kpts =
-        keypoints_flipped.cols(sample_indices);
-
-    // Compute camera pose using P3P or DLT.
-    arma::cube R_C_W_guess(3, 3, 4, arma::fill::zeros);
-    arma::cube t_C_W_guess(3, 1, 4, arma::fill::zeros);
-    if (method == uzh::P3P) {
-      const arma::mat bearing_vectors =
-          K.i() *
-          arma::conv_to<arma::mat>::from(uzh::homogeneous(corresponding_kpts));
-      // P3P require three unitary bearing vectors.
-      const arma::mat unitary_bearing_vectors =
-          arma::normalise(bearing_vectors);
-      Eigen::Matrix<Eigen::Matrix<double, 3, 4>, 4, 1> poses;
-      uzh::P3P::computePoses(uzh::arma2eigen(unitary_bearing_vectors),
-                             uzh::arma2eigen(landmark_samples), poses);
-      // Unpack the result of P3P.
-      for (int i = 0; i < poses.rows(); ++i) {
-        // const Eigen::Matrix<double, 3, 4> pose_tmp = poses(i, 0);
-        const arma::mat pose = uzh::eigen2arma(poses(i, 0));
-        //! P3P returns R_W_C rather than R_C_W.
-        //! R_C_W = R_W_C', where ' denotes transpose.
-        //! t_C_W = -R_W_C' * t_W_C.
-        const arma::mat33 R_W_C = pose.head_cols(3);
-        const arma::vec3 t_W_C = pose.tail_cols(1);
-        R_C_W_guess.slice(i) = R_W_C.t();
-        t_C_W_guess.slice(i) = -R_W_C.t() * t_W_C;
-      }
-
-      // If method is DLT
-    } else {
-      uzh::CameraMatrixDLT M_DLT = uzh::EstimatePoseDLT(
-          uzh::arma2eigen(arma::conv_to<arma::mat>::from(corresponding_kpts)),
-          uzh::arma2eigen(landmark_samples), uzh::arma2eigen(K));
-      M_DLT.DecomposeDLT();
-      const arma::mat M_C_W = uzh::eigen2arma(M_DLT.getM());
-      R_C_W_guess.slice(0) = M_C_W.head_cols(3);
-      t_C_W_guess.slice(0) = M_C_W.tail_cols(1);
-    }
+    const arma::uvec sample_indices =
+        prosac_sampler ? prosac_sampler->Sample(k + 1, &generator)
+                       : internal::SampleDistinctIndices(
+                             s, kNumCorrespondences, &generator);
+    const uzh::LocalizationHypothesis hypothesis =
+        uzh::ScoreLocalizationHypothesis(
+            method, correspondences, K_eigen, sample_indices,
+            kSquaredTolerance, sprt_verifier ? &*sprt_verifier : nullptr);
 
-    // Compute reprojection error to identify inliers.
-    // Transform landmarks to camera frame and then project.
-    arma::mat landmarks_C =
-        R_C_W_guess.slice(0) * landmarks +
-        arma::repmat(t_C_W_guess.slice(0), 1, kNumCorrespondences);
-    Eigen::Matrix2Xd projected_points_eigen;
-    uzh::ProjectPoints(uzh::arma2eigen(landmarks_C), &projected_points_eigen,
-                       uzh::arma2eigen(K));
-    arma::mat projected_points = uzh::eigen2arma(projected_points_eigen);
-    arma::rowvec residuals =
-        arma::sum(arma::square(projected_points - keypoints_flipped));
-    arma::urowvec inlier_mask =
-        (residuals < (kPixelTolerance * kPixelTolerance));
-
-    // Process another 3 three pose guesses if using P3P.
-    if (method == uzh::P3P) {
-      for (int i = 1; i < 4; ++i) {
-        landmarks_C =
-            R_C_W_guess.slice(i) * landmarks +
-            arma::repmat(t_C_W_guess.slice(i), 1, kNumCorrespondences);
-        uzh::ProjectPoints(uzh::arma2eigen(landmarks_C),
-                           &projected_points_eigen, uzh::arma2eigen(K));
-        projected_points = uzh::eigen2arma(projected_points_eigen);
-        residuals =
-            arma::sum(arma::square(projected_points - keypoints_flipped));
-        arma::urowvec alternative_inlier_mask =
-            (residuals < (kPixelTolerance * kPixelTolerance));
-
-        // Get the best inlier mask among all possible poses obtained from P3P.
-        if (uzh::nnz<arma::uword>(alternative_inlier_mask) >
-            uzh::nnz<arma::uword>(inlier_mask)) {
-          inlier_mask = alternative_inlier_mask;
-        }
-      }
-    }
-
-    // Update best inlier mask if more inliers are found.
+    // Update best hypothesis if more inliers are found.
 
     // If tweak_for_more_robust is true, lift the threshold of the minimum
-    // number of inliers exceed which the best inlier mask is then updated.
+    // number of inliers exceed which the best hypothesis is then updated.
     const int min_num_inliers_threshold = tweak_for_more_robust ? 30 : 6;
 
-    const int num_inliers = arma::size(arma::nonzeros(inlier_mask)).n_rows;
+    const int num_inliers = hypothesis.num_inliers;
     if (num_inliers > min_num_inliers_threshold &&
         num_inliers >= max_num_inliers) {
       max_num_inliers = num_inliers;
-      best_inlier_mask = inlier_mask;
+      best_hypothesis = hypothesis;
+      // The accepted poses are verified against all correspondences, hence
+      // the inlier ratio of the best one is exact.
+      if (sprt_verifier) {
+        sprt_verifier->test.UpdateEpsilon(
+            std::max(max_num_inliers / double(kNumCorrespondences),
+                     1 - kLocalizationMaxOutlierRatio));
+      }
     }
 
     // Adaptively change number of iterations
     if (adaptive_iterations) {
-      // Upper bound of outlier ratio is set to 0.90
-      outlier_ratio =
-          std::min(1 - max_num_inliers / double(kNumCorrespondences), 0.90);
-      // Confidence about how much correspondences are inliers.
-      const double confidence = 0.95;
-      num_iterations = std::log(1 - confidence) /
-                       std::log(1 - std::pow((1 - outlier_ratio), s));
-      // Set the upper bound of number of iterations.
-      num_iterations = std::min(num_iterations, 15000.0);
+      num_iterations = uzh::AdaptiveLocalizationIterations(
+          max_num_inliers, kNumCorrespondences, method, &outlier_ratio);
+      if (sprt_verifier) {
+        num_iterations = std::min(sprt_verifier->test.AdaptiveIterations(
+                                      kLocalizationConfidence, s),
+                                  double(kLocalizationMaxIterations));
+      }
     }
 
     // Record the maximum number of inliers and number of iterations.
@@ -218,26 +249,23 @@ RANSACLocalization(const arma::umat& keypoints, const arma::mat& landmarks,
 
   // If RANSAC succeeds, refine the result.
   if (max_num_inliers > 0) {
+    // The inlier mask is only formed for the best hypothesis.
+    best_inlier_mask = uzh::ReprojectionInlierMask(
+        best_hypothesis.R_C_W, best_hypothesis.t_C_W, K_eigen, correspondences,
+        kSquaredTolerance);
     // Refine the pose using DLT with more correspondences as P3P always use 3.
-    arma::mat33 R_C_W_final;
-    arma::vec3 t_C_W_final;
-    uzh::CameraMatrixDLT M_DLT_final = uzh::EstimatePoseDLT(
-        uzh::arma2eigen(arma::conv_to<arma::mat>::from(
-            keypoints_flipped.cols(arma::find(best_inlier_mask)))),
-        uzh::arma2eigen(landmarks.cols(arma::find(best_inlier_mask))),
-        uzh::arma2eigen(K));
-    M_DLT_final.DecomposeDLT();
-    const arma::mat M_C_W_final = uzh::eigen2arma(M_DLT_final.getM());
-    R_C_W_final = M_C_W_final.head_cols(3);
-    t_C_W_final = M_C_W_final.tail_cols(1);
+    std::tie(R_C_W, t_C_W) = uzh::RefineLocalizationDLT(
+        keypoints_flipped, landmarks, best_inlier_mask, K);
 
     if (adaptive_iterations) {
       // Display adapted number of iterations and outlier ratio.
-      std::cout << "Adaptive RANSAC: converged after " << k << " iterations.\n";
-      std::cout << "Adaptive RANSAC: estimated outlier ratio is "
-                << outlier_ratio * 100 << "%\n";
+      // LOG writes each message at once, hence the messages of concurrent
+      // calls do not interleave.
+      LOG(INFO) << "Adaptive RANSAC: converged after " << k << " iterations.";
+      LOG(INFO) << "Adaptive RANSAC: estimated outlier ratio is "
+                << outlier_ratio * 100 << "%";
     }
-    return {R_C_W_final, t_C_W_final, best_inlier_mask,
+    return {R_C_W, t_C_W, best_inlier_mask,
             arma::conv_to<arma::urowvec>::from(max_num_inliers_history),
             arma::conv_to<arma::rowvec>::from(num_iterations_history)};
   } else {
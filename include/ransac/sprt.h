@@ -0,0 +1,151 @@
+#ifndef UZH_RANSAC_SPRT_H_
+#define UZH_RANSAC_SPRT_H_
+
+#include <algorithm>  // std::max
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace uzh {
+
+// Initial probability of a data point being consistent with a bad model.
+constexpr double kSprtInitialDelta = 0.01;
+// Relative change of delta above which a new test is designed.
+constexpr double kSprtDeltaTolerance = 0.05;
+
+//@brief Wald's sequential probability ratio test (SPRT) deciding whether a
+// RANSAC hypothesis is bad from a few data points, "Optimal Randomized RANSAC"
+// by Chum and Matas.
+//! The data points are verified in random order, and the likelihood ratio
+//! lambda = p(points | bad model) / p(points | good model) is multiplied by
+//! delta / epsilon for each consistent point and by
+//! (1 - delta) / (1 - epsilon) for each inconsistent one, where epsilon is the
+//! probability of a point being consistent with a good model, i.e. the inlier
+//! ratio, and delta that with a bad model. The model is rejected as soon as
+//! lambda exceeds the decision threshold A, which minimizes the expected time
+//! of RANSAC given the time of computing the models of a sample, and
+//! otherwise verified against all points as usual.
+//! Both probabilities are estimated online: epsilon from the best model so
+//! far and delta from the fraction of consistent points of the rejected
+//! models. Each change designs a new test, whose number of samples is kept for
+//! the termination criterion, see AdaptiveIterations.
+class SPRT {
+ public:
+  //@param model_time Time of drawing a sample and computing its models, in
+  // units of the time of verifying one data point.
+  //@param num_models_per_sample Average number of models per sample.
+  //@param epsilon Initial inlier ratio.
+  //@param delta Initial probability of a point being consistent with a bad
+  // model.
+  SPRT(const double model_time, const double num_models_per_sample,
+       const double epsilon, const double delta = kSprtInitialDelta)
+      : model_time_(model_time),
+        num_models_per_sample_(num_models_per_sample),
+        epsilon_(epsilon),
+        delta_(delta) {
+    DesignTest();
+  }
+
+  //@brief Increments of log(lambda) for a consistent and an inconsistent
+  // data point.
+  double log_consistent() const { return log_consistent_; }
+  double log_inconsistent() const { return log_inconsistent_; }
+  //@brief log(A), which is infinite if the test cannot reject, i.e. if
+  // epsilon <= delta.
+  double log_decision_threshold() const { return log_decision_threshold_; }
+  double epsilon() const { return epsilon_; }
+  double delta() const { return delta_; }
+
+  //@brief Count a sample drawn under the current test.
+  void AddSample() { ++tests_.back().num_samples; }
+
+  //@brief Update delta with a rejected model, consistent with num_consistent
+  // out of the num_verified points verified before the rejection.
+  void Reject(const int num_consistent, const int num_verified) {
+    num_rejected_consistent_ += num_consistent;
+    num_rejected_verified_ += num_verified;
+    const double kDelta =
+        std::max(num_rejected_consistent_ / num_rejected_verified_,
+                 std::numeric_limits<double>::epsilon());
+    if (std::abs(kDelta - delta_) > kSprtDeltaTolerance * delta_) {
+      delta_ = kDelta;
+      DesignTest();
+    }
+  }
+
+  //@brief Update epsilon with the inlier ratio of a new best model.
+  void UpdateEpsilon(const double epsilon) {
+    if (epsilon == epsilon_) return;
+    epsilon_ = epsilon;
+    DesignTest();
+  }
+
+  //@brief Number of samples after which the probability of having missed a
+  // good model, given the current epsilon, drops below 1 - confidence.
+  //! An uncontaminated sample yields a good model, which is accepted with
+  //! probability 1 - 1 / A by Wald's bound. Hence each test i, under which
+  //! k_i samples have been drawn, misses it with probability
+  //! eta_i = (1 - epsilon^m * (1 - 1 / A_i))^k_i for samples of size m. The
+  //! samples of all tests are accounted for, and those still needed are
+  //! drawn under the current test.
+  //@param confidence Probability of having drawn a good model when stopping.
+  //@param sample_size Number of data points of a sample.
+  double AdaptiveIterations(const double confidence,
+                            const int sample_size) const {
+    const double kProbabilityGood = std::pow(epsilon_, sample_size);
+    const auto log_miss = [kProbabilityGood](const double log_A) {
+      return std::log(1 - kProbabilityGood * (1 - std::exp(-log_A)));
+    };
+    double log_eta = 0;
+    int num_samples = 0;
+    for (const Test& test : tests_) {
+      log_eta += test.num_samples * log_miss(test.log_decision_threshold);
+      num_samples += test.num_samples;
+    }
+    const double kLogMiss = log_miss(log_decision_threshold_);
+    if (!(kLogMiss < 0)) return std::numeric_limits<double>::infinity();
+    return num_samples +
+           std::max(0.0, (std::log(1 - confidence) - log_eta) / kLogMiss);
+  }
+
+ private:
+  //@brief Compute A for the current epsilon and delta by iterating
+  // A = t_M * C / m_S + 1 + log(A), where t_M is the time of computing the
+  // models of a sample, m_S the number of models per sample and C the
+  // expected decrease of log(lambda) per point of a bad model.
+  void DesignTest() {
+    log_consistent_ = std::log(delta_ / epsilon_);
+    log_inconsistent_ = std::log((1 - delta_) / (1 - epsilon_));
+    if (!(epsilon_ > delta_) || !(epsilon_ < 1)) {
+      log_decision_threshold_ = std::numeric_limits<double>::infinity();
+    } else {
+      const double C =
+          (1 - delta_) * log_inconsistent_ + delta_ * log_consistent_;
+      const double A_0 = model_time_ * C / num_models_per_sample_ + 1;
+      double A = A_0;
+      for (int i = 0; i < 20; ++i) {
+        const double kNextA = A_0 + std::log(A);
+        const bool kConverged = std::abs(kNextA - A) < 1e-6 * A;
+        A = kNextA;
+        if (kConverged) break;
+      }
+      log_decision_threshold_ = std::log(A);
+    }
+    tests_.push_back({log_decision_threshold_, 0});
+  }
+
+  struct Test {
+    double log_decision_threshold;
+    int num_samples;
+  };
+
+  double model_time_, num_models_per_sample_;
+  double epsilon_, delta_;
+  double log_consistent_, log_inconsistent_, log_decision_threshold_;
+  double num_rejected_consistent_ = 0, num_rejected_verified_ = 0;
+  std::vector<Test> tests_;
+};
+
+}  // namespace uzh
+
+#endif  // UZH_RANSAC_SPRT_H_
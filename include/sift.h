@@ -8,6 +8,16 @@
 #include "sift/compute_image_pyramid.h"
 #include "sift/derotate.h"
 #include "sift/extract_keypoints.h"
+#include "sift/find_extrema.h"
 #include "sift/get_image_sift.h"
+#include "sift/gradient_cache.h"
+#include "sift/hog_descriptor.h"
+#include "sift/parallel_sift.h"
+#include "sift/quantize_descriptors.h"
+#include "sift/refine_keypoints.h"
+#include "sift/scale_space.h"
+#include "sift/sift_parameters.h"
+#include "sift/streaming_sift.h"
+#include "sift/tiled_sift.h"
 
 #endif  // UZH_SIFT_H_
\ No newline at end of file
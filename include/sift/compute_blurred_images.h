@@ -10,6 +10,26 @@
 
 namespace uzh {
 
+//@brief Blur the i-th image of an octave.
+//@param octave_image Original image of the octave to be blurred.
+//@param i Index of the blurred image in the octave, i = 0, ..., num_scales + 2.
+//@param num_scales Number of scales per octave.
+//@param base_sigma Base sigma from which the sigma of the i-th image is
+// generated.
+//@return The blurred image.
+arma::mat ComputeBlurredImage(const cv::Mat& octave_image, const int i,
+                              const int num_scales, const double base_sigma) {
+  // Such that s = [-1, 0, ..., num_scales + 1], 6 indices in total.
+  // FIXME This range could also be changed,
+  // e.g. s = [0, ..., num_scales + 2].
+  cv::Mat blurred_image;
+  const int s = i - 1;
+  const double sigma = std::pow(2, s / (double)num_scales) * base_sigma;
+  cv::GaussianBlur(octave_image, blurred_image, {}, sigma, sigma,
+                   cv::BORDER_ISOLATED);
+  return uzh::cv2arma<double>(blurred_image).t();
+}
+
 //@brief Compute blurred images for all images in the image pyramid.
 //! Images in a certain octave are blurred with Gaussians of different sigmas.
 //! Images in different octaves are blurred with the same set of Gaussians.
@@ -35,15 +55,8 @@ arma::field<arma::cube> ComputeBlurredImages(
         image_pyramid(o).rows, image_pyramid(o).cols, kImagesPerOctave);
     // Gaussian blur images in an octave with increasing sigmas.
     for (int i = 0; i < kImagesPerOctave; ++i) {
-      // Such that s = [-1, 0, ..., num_scales + 1], 6 indices in total.
-      // FIXME This range could also be changed,
-      // e.g. s = [0, ..., num_scales + 2].
-      cv::Mat blurred_image;
-      const int s = i - 1;
-      const double sigma = std::pow(2, s / (double)num_scales) * base_sigma;
-      cv::GaussianBlur(image_pyramid(o), blurred_image, {}, sigma, sigma,
-                       cv::BORDER_ISOLATED);
-      octave.slice(i) = uzh::cv2arma<double>(blurred_image).t();
+      octave.slice(i) =
+          ComputeBlurredImage(image_pyramid(o), i, num_scales, base_sigma);
     }
     blurred_images(o) = octave;
   }
@@ -5,13 +5,14 @@
 #include <tuple>
 #include <vector>
 
-#include "algorithm/weightedhist.h"
 #include "armadillo"
 #include "glog/logging.h"
 #include "matlab_port/cell2mat.h"
-#include "matlab_port/fspecial.h"
-#include "matlab_port/imgradient.h"
 #include "sift/derotate.h"
+#include "sift/gradient_cache.h"
+#include "sift/hog_descriptor.h"
+#include "sift/quantize_descriptors.h"
+#include "transfer/view.h"
 
 namespace uzh {
 
@@ -28,17 +29,20 @@ namespace uzh {
 //@param rotation_invariant Boolean value used to denote whether the computed
 // descriptors are invariant to rotation or not. If true, a dominant orientation
 // will be assigned to each descriptor.
+//@param trilinear Whether the gradients are binned with trilinear
+// interpolation, see ComputeHOGDescriptor.
 std::tuple<arma::mat /*descriptors*/, arma::umat /*final_keypoints*/>
 ComputeDescriptors(const arma::field<arma::cube>& blurred_images,
                    const arma::field<arma::umat>& keypoints,
-                   const bool rotation_invariant = false) {
+                   const bool rotation_invariant = false,
+                   const bool trilinear = false) {
   if (blurred_images.size() != keypoints.size())
     LOG(ERROR) << "The number of octaves are not consistent.";
   const int kNumOctaves = blurred_images.size();
 
-  // The magic number 1.5 is taken from Lowe's paper.
-  const arma::mat gaussian_kernel =
-      uzh::cv2arma<double>(uzh::fspecial(uzh::GAUSSIAN, 16, 16.0 * 1.5)).t();
+  // Gradients of the slices are computed on demand and shared by the
+  // orientation assignment and the descriptors.
+  uzh::GradientCache gradient_cache(blurred_images);
 
   // Construct fields of descriptors and keypoints to be populated.
   std::vector<arma::mat> descs_container;
@@ -51,7 +55,7 @@ ComputeDescriptors(const arma::field<arma::cube>& blurred_images,
     // Get the blurred images and keypoints in current octave
     // oct_blurred_images [w x h x num_images_per_octave]
     // oct_keypoints [3 x n] where the last row is the scale.
-    const arma::cube oct_blurred_images = blurred_images(o);
+    const arma::cube& oct_blurred_images = blurred_images(o);
     const arma::umat oct_keypoints = keypoints(o);
 
     // Only consider relevant images involved in the extraction of the
@@ -70,11 +74,14 @@ ComputeDescriptors(const arma::field<arma::cube>& blurred_images,
       const arma::umat kept_keypoints_3d = oct_keypoints.cols(is_kept_in_image);
       arma::umat kept_keypoints_2d = kept_keypoints_3d.head_rows(2);
 
-      // Compute image gradient for use of Histogram of Oriented Gradients.
-      const arma::mat image = oct_blurred_images.slice(img_idx);
-      const arma::field<arma::mat> gradient = uzh::imgradient(image);
-      const arma::mat grad_magnitude = gradient(0);
-      const arma::mat grad_direction = gradient(1);
+      // Fetch image gradient for use of Histogram of Oriented Gradients.
+      const arma::mat& image = oct_blurred_images.slice(img_idx);
+      const arma::field<arma::mat>& gradient =
+          gradient_cache.Get(o, img_idx);
+      const uzh::StridedView<double> grad_magnitude =
+          uzh::strided_view(gradient(0));
+      const uzh::StridedView<double> grad_direction =
+          uzh::strided_view(gradient(1));
 
       // Construct descriptor matrix for the current image.
       const int kNumKeypoints = kept_keypoints_2d.n_cols;
@@ -96,69 +103,21 @@ ComputeDescriptors(const arma::field<arma::cube>& blurred_images,
         const int start_col = kept_keypoints_2d(1, corner_idx);
 
         // Ensure all the pixels inside the patch are within the image boundary.
-        // The patch is 16 x 16, so we take the point 8 pixels away from the
-        // upper left and 7 pixels aways from the lower right as the anchor
-        // point.
-        if (start_row >= 8 && start_col >= 8 && start_row < image.n_rows - 15 &&
-            start_col < image.n_cols - 15) {
+        if (IsDescribable(start_row, start_col, image.n_rows, image.n_cols)) {
           is_valid(corner_idx) = 1;
-          // Convolve the patch with the Gaussian window.
-          const arma::mat patch_grad_mag =
-              grad_magnitude(start_row - 8, start_col - 8, arma::size(16, 16));
-          // Note the gaussian_kernel is symmetric, hence no need to flip it
-          // around. The % operator is element-wise multiplication.
-          const arma::mat patch_grad_mag_w = patch_grad_mag % gaussian_kernel;
-          // Gradient direction is unchanged after convolution.
-          const arma::mat patch_grad_dir =
-              grad_direction(start_row - 8, start_col - 8, arma::size(16, 16));
 
           // If rotation_invariant is true, derotate the patch based on the
           // dominant orientation to achieve rotation invariance.
-          // Clone the patch to be derotated.
-          arma::mat derotated_patch_grad_mag_w = patch_grad_mag_w;
-          arma::mat derotated_patch_grad_dir = patch_grad_dir;
-
-          if (rotation_invariant) {
-            // TODO(bayes)
-          }
-
-          // Compute the descriptor for this patch using Histogram of Oriented
-          // Gradients.
-          // The current 16 x 16 patch is divided into 4 subpatches, and each
-          // [8 x 8] subpatches is then divided into 4 quadrants, i.e.
-          // 4 * [4 x 4] subsubpatches. For each quadrant, an 8-bit histogram of
-          // the orientations of the gradients is computed. The 8 values of the
-          // histogram is then populated into the corresponding subvector of the
-          // current descriptor vector. Hence the length of the descriptor
-          // vector is 4 * 4 * 8 = 128.
-
-          // Starting index of the current subvector in the descriptor vector.
-          int start_idx = 0;
-          // Iterate over each quadrant in the current patch. There's in total
-          // 4 * 4 = 16 quadrants.
-          for (int j = 0; j < 4; ++j) {
-            for (int i = 0; i < 4; ++i) {
-              // Compute histogram for the current (i, j)-th quadrant.
-              // Before creating the histogram, the orientations of gradients
-              // are weighted according to the gradients magnitude.
-              // derotated_patch_grad_dir(4 * j, 4 * i, arma::size(4, 4))
-              //     .print("patch dir\n");
-              // derotated_patch_grad_mag_w(4 * j, 4 * i, arma::size(4, 4))
-              //     .print("patch mag\n");
-              const arma::vec hist =
-                  uzh::weightedhist(arma::vectorise(derotated_patch_grad_dir(
-                                        4 * j, 4 * i, arma::size(4, 4))),
-                                    arma::vectorise(derotated_patch_grad_mag_w(
-                                        4 * j, 4 * i, arma::size(4, 4))),
-                                    arma::linspace<arma::vec>(-180, 180, 9));
-
-              // Populate the subvector of the descriptor vector.
-              img_descriptor.col(corner_idx).subvec(start_idx, start_idx + 7) =
-                  hist.head(8);
-              // hist.print("hist\n");
-              start_idx += 8;
-            }
-          }
+          const double orientation =
+              rotation_invariant
+                  ? uzh::ComputeDominantOrientation(
+                        grad_magnitude, grad_direction, start_row, start_col)
+                  : 0.0;
+
+          uzh::ComputeHOGDescriptor(grad_magnitude, grad_direction, start_row,
+                                    start_col, trilinear,
+                                    img_descriptor.colptr(corner_idx),
+                                    orientation);
         }
       }
       // Adapt keypoint coordinates such that they correspond to the original
@@ -197,6 +156,23 @@ ComputeDescriptors(const arma::field<arma::cube>& blurred_images,
   return {normalized_descriptors, final_keypoints};
 }
 
+//@brief Quantized output mode of ComputeDescriptors, see
+// QuantizeSIFTDescriptors.
+//@return descriptors -- [128 x n] uint8 matrix where each column is a
+// quantized descriptor; final_keypoints -- as ComputeDescriptors.
+std::tuple<arma::Mat<unsigned char> /*descriptors*/,
+           arma::umat /*final_keypoints*/>
+ComputeQuantizedDescriptors(const arma::field<arma::cube>& blurred_images,
+                            const arma::field<arma::umat>& keypoints,
+                            const bool rotation_invariant = false,
+                            const bool trilinear = false) {
+  arma::mat descriptors;
+  arma::umat final_keypoints;
+  std::tie(descriptors, final_keypoints) = ComputeDescriptors(
+      blurred_images, keypoints, rotation_invariant, trilinear);
+  return {uzh::QuantizeSIFTDescriptors(descriptors), final_keypoints};
+}
+
 }  // namespace uzh
 
 #endif  // UZH_SIFT_COMPUTE_DESCRIPTORS_H_
\ No newline at end of file
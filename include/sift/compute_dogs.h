@@ -2,14 +2,20 @@
 #define UZH_SIFT_COMPUTE_DOGS_H_
 
 #include "armadillo"
+#include "opencv2/core.hpp"
+#include "sift/scale_space.h"
 
 namespace uzh {
 
 //@brief Compute difference of Gaussians from adjacent images in each octave.
 //@param blurred_images Blurred images obtained from ComputeBlurredImages.
+//@param absolute If true, the absolute DoGs are returned such that both the
+// maxima and the minima can be found as maxima. Otherwise the signed DoGs are
+// returned, whose extrema are found with FindExtrema with MAXIMA_AND_MINIMA.
 //@return Difference of Gaussians of all octaves.
 arma::field<arma::cube> ComputeDoGs(
-    const arma::field<arma::cube>& blurred_images) {
+    const arma::field<arma::cube>& blurred_images,
+    const bool absolute = true) {
   const int kNumOctaves = blurred_images.size();
   // DoGs contains DoGs of all octaves.
   arma::field<arma::cube> DoGs(kNumOctaves);
@@ -27,9 +33,10 @@ arma::field<arma::cube> ComputeDoGs(
                                              arma::size(0, 0, 1));
     const int kNumDoGsPerOctave = DoG.n_slices;
     for (int d = 0; d < kNumDoGsPerOctave; ++d) {
+      DoG.slice(d) =
+          blurred_images(o).slice(d + 1) - blurred_images(o).slice(d);
       // arma::abs to ensure every element is not negative.
-      DoG.slice(d) = arma::abs(blurred_images(o).slice(d + 1) -
-                               blurred_images(o).slice(d));
+      if (absolute) DoG.slice(d) = arma::abs(DoG.slice(d));
     }
 
     DoGs(o) = DoG;
@@ -37,6 +44,23 @@ arma::field<arma::cube> ComputeDoGs(
   return DoGs;
 }
 
+//@brief Compute the signed difference of Gaussians of one octave of the scale
+// space computed by ComputeScaleSpace.
+//@return The DoGs stored the same way as the blurred images, i.e. num_images
+// is one less than the one of octave.
+uzh::ScaleSpaceOctave ComputeDoGs(const uzh::ScaleSpaceOctave& octave) {
+  uzh::ScaleSpaceOctave DoG;
+  DoG.rows = octave.rows;
+  DoG.cols = octave.cols;
+  DoG.num_images = octave.num_images - 1;
+  DoG.data.create(DoG.num_images * DoG.rows, DoG.cols, CV_32F);
+  //! Adjacent images are adjacent row ranges of the contiguous buffer, hence
+  //! all DoGs are computed with a single subtraction.
+  cv::subtract(octave.data.rowRange(octave.rows, octave.data.rows),
+               octave.data.rowRange(0, DoG.data.rows), DoG.data);
+  return DoG;
+}
+
 }  // namespace uzh
 
 #endif  // UZH_SIFT_COMPUTE_DOGS_H_
\ No newline at end of file
@@ -1,6 +1,65 @@
 #ifndef UZH_SIFT_DEROTATE_H_
 #define UZH_SIFT_DEROTATE_H_
 
-// TODO(bayes)
+#include <algorithm>  // std::max_element
+#include <array>
+#include <cmath>
 
-#endif  // UZH_SIFT_DEROTATE_H_
\ No newline at end of file
+#include "transfer/view.h"
+
+namespace uzh {
+
+//@brief Compute the dominant orientation of the keypoint at (row, col) from the
+// gradients around it, such that the patch can be derotated accordingly.
+//! A 36-bin histogram of the gradient directions, 10 degrees per bin, is
+//! accumulated over the 16 x 16 patch used by the descriptor. The votes are
+//! weighted by the gradient magnitude and a Gaussian window whose 3 sigma
+//! equals the patch radius. The peak is then refined by fitting a parabola to
+//! the peak bin and its two circular neighbours, as in Lowe's paper.
+//! The keypoint must be describable, see IsDescribable.
+//@param grad_magnitude Gradient magnitude of the image the keypoint lies on.
+//@param grad_direction Gradient direction in degrees in [-180, 180] of the
+// same image.
+//@return The dominant orientation in degrees in [-180, 180).
+template <typename T>
+double ComputeDominantOrientation(const uzh::StridedView<T>& grad_magnitude,
+                                  const uzh::StridedView<T>& grad_direction,
+                                  const int row, const int col) {
+  const int kNumBins = 36;
+  const double kBinWidth = 360.0 / kNumBins;
+  const double kSigma = 8.0 / 3.0;
+  std::array<double, kNumBins> hist{};
+
+  for (int r = -8; r < 8; ++r) {
+    for (int c = -8; c < 8; ++c) {
+      // Offsets from the center of the patch.
+      const double dr = r + 0.5, dc = c + 0.5;
+      const double weight =
+          std::exp(-(dr * dr + dc * dc) / (2 * kSigma * kSigma));
+      int bin = static_cast<int>(
+          (grad_direction(row + r, col + c) + 180.0) / kBinWidth);
+      // 180 degrees wraps to bin 0.
+      if (bin >= kNumBins) bin -= kNumBins;
+      hist[bin] += weight * grad_magnitude(row + r, col + c);
+    }
+  }
+
+  const int peak = static_cast<int>(
+      std::max_element(hist.begin(), hist.end()) - hist.begin());
+  const double left = hist[(peak + kNumBins - 1) % kNumBins];
+  const double center = hist[peak];
+  const double right = hist[(peak + 1) % kNumBins];
+  // Vertex of the parabola through the three bins, in [-0.5, 0.5] bins.
+  const double denominator = left - 2 * center + right;
+  const double offset =
+      denominator < 0 ? 0.5 * (left - right) / denominator : 0.0;
+
+  double orientation = -180.0 + (peak + 0.5 + offset) * kBinWidth;
+  if (orientation >= 180.0) orientation -= 360.0;
+  if (orientation < -180.0) orientation += 360.0;
+  return orientation;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_DEROTATE_H_
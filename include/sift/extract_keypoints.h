@@ -2,9 +2,28 @@
 #define UZH_SIFT_EXTRACT_KEYPOINTS_H_
 
 #include "armadillo"
+#include "sift/find_extrema.h"
 
 namespace uzh {
 
+//@brief Extract keypoints from the maximums both in scale and space of the
+// DoGs of one octave.
+//@param DoG Difference of Gaussians of one octave.
+//@param keypoints_threshold Below which the points are suppressed before
+// selection of keypoitns to attenuate effect of noise.
+//@return [3 x n] coordinate matrix where keypoints are stored column by
+// column. The coordinates are 3D vectors where the first two dimensions are row
+// and col coordinates and the last dimension corresponds to scale.
+arma::umat ExtractOctaveKeypoints(const arma::cube& DoG,
+                                  const double keypoints_threshold) {
+  // Locate the maximums with a separable 3 x 3 x 3 max filter.
+  //! The moving max filter used to be applied by dilating a zero-padded copy
+  //! of the DoG. FindExtrema streams over the slices instead and skips the
+  //! 1-pixel spatial border, which is discarded by ComputeDescriptors anyway.
+  //! The first and last slices are only used as neighbours, as before.
+  return uzh::FindExtrema(DoG, keypoints_threshold, uzh::MAXIMA);
+}
+
 //@brief Extract keypoints from the maximums both in scale and space.
 //@param DoGs Difference of Gaussians computed from ComputeDoGs.
 //@param keypoints_threshold Below which the points are suppressed before
@@ -20,59 +39,7 @@ arma::field<arma::umat> ExtractKeypoints(const arma::field<arma::cube>& DoGs,
   // For each octave, locate the maximums both in scale and space from the DoGs
   // in this octave.
   for (int o = 0; o < kNumOctaves; ++o) {
-    // Copy the DoG
-    arma::cube DoG = DoGs(o);
-
-    // Locate the maximums
-    //! A neat trick: use dilation in place of moving max filter.
-    //@ref
-    // https://en.wikipedia.org/wiki/Dilation_(morphology)#Flat_structuring_functions
-
-    //! Here, by making use of armadillo's subview, we can achieve this in an
-    //! efficient manner.
-    // TODO(bayes) Modularize the codes below, wrapping into the imdilate
-    // function.
-
-    // First pre-pad the cube along each dimension to avoid boundary issues.
-    const arma::cube kMaxFilter = arma::ones<arma::cube>(3, 3, 3);
-    // TODO(bayes) Modularize the codes below, wrappint into the padarray
-    // function.
-    const int kPadSize = static_cast<int>(std::floor(
-        kMaxFilter.n_rows / 2.0));  // Padding size equals to the
-                                    // radius of the moving max filter.
-    arma::cube padded_DoG = arma::zeros<arma::cube>(
-        arma::size(DoG) + arma::size(kPadSize * 2, kPadSize * 2, kPadSize * 2));
-    // Copy the elements from DoG to the padded_DoG
-    padded_DoG(1, 1, 1, arma::size(DoG)) = DoG;
-    // Apply moving max filter.
-    arma::cube DoG_max = arma::zeros<arma::cube>(arma::size(DoG));
-    for (int slice = 0; slice < DoG_max.n_slices; ++slice) {
-      for (int row = 0; row < DoG_max.n_rows; ++row) {
-        for (int col = 0; col < DoG_max.n_cols; ++col) {
-          DoG_max(row, col, slice) =
-              padded_DoG(row, col, slice, arma::size(kMaxFilter)).max();
-        }
-      }
-    }
-
-    // Filter out all points but the ones survived in the max filtering which
-    // are then be thresholded.
-    //! This is equivalent to doing a non-maximum suppression around the
-    //! keypoints selected as above followed by a thresholding.
-    arma::ucube is_kept_kpts =
-        ((DoG == DoG_max) && (DoG >= keypoints_threshold));
-
-    // Discard the keypoints found in the lowest and highest layers of the
-    // current DoG because the two layers are involved with padded borders.
-    is_kept_kpts.head_slices(1).zeros();
-    is_kept_kpts.tail_slices(1).zeros();
-
-    // Obtain the corresponding 3D coordinates of each putative keypoints.
-    arma::umat coordinates_3d =
-        arma::ind2sub(arma::size(is_kept_kpts), arma::find(is_kept_kpts));
-
-    // Store them into the keypoints.
-    keypoints(o) = coordinates_3d;
+    keypoints(o) = ExtractOctaveKeypoints(DoGs(o), keypoints_threshold);
   }
 
   return keypoints;
@@ -0,0 +1,169 @@
+#ifndef UZH_SIFT_FIND_EXTREMA_H_
+#define UZH_SIFT_FIND_EXTREMA_H_
+
+#include <algorithm>  // std::max, std::min
+#include <cstdint>
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "opencv2/core.hpp"
+#include "sift/scale_space.h"
+
+namespace uzh {
+
+//@brief Kinds of extrema searched by FindExtrema.
+// MAXIMA: points not less than their 26 neighbours and not less than the
+// threshold, the only kind found in absolute DoGs.
+// MINIMA: points not greater than their 26 neighbours and not greater than the
+// negated threshold.
+// MAXIMA_AND_MINIMA: both of the above, for signed DoGs.
+enum ExtremumType : int { MAXIMA, MINIMA, MAXIMA_AND_MINIMA };
+
+//@brief Find the extrema of the middle slice of three adjacent DoG slices.
+//! The 3 x 3 x 3 max (min) filter is decomposed into two separable passes
+//! over one row at a time:
+//! - a vertical pass reducing the 9 values of each column across the three
+//!   slices and the three rows to a row buffer;
+//! - a horizontal pass reducing three adjacent entries of the row buffer.
+//! Both passes are plain loops over contiguous columns which the compiler
+//! vectorises, and each voxel is read 9 times instead of 27.
+//! The 1-pixel spatial border is skipped since its neighbourhood is
+//! incomplete.
+//@param prev, curr, next Single channel DoG slices whose depth corresponds to
+// T. They can be ROIs of larger matrices.
+//@param threshold Extrema whose absolute value is below it are discarded.
+//@param extremum_type One of ExtremumType.
+//@param extrema Output extrema of curr as cv::Point2i(col, row), which are
+// appended in row-major order.
+template <typename T>
+void FindExtremaInSlice(const cv::Mat& prev, const cv::Mat& curr,
+                        const cv::Mat& next, const double threshold,
+                        const int extremum_type,
+                        std::vector<cv::Point2i>* extrema) {
+  if (prev.size() != curr.size() || next.size() != curr.size())
+    LOG(ERROR) << "DoG slices must be of the same size.";
+  const int rows = curr.rows, cols = curr.cols;
+  if (rows < 3 || cols < 3) return;
+
+  const bool find_maxima = extremum_type != uzh::MINIMA;
+  const bool find_minima = extremum_type != uzh::MAXIMA;
+  const T kMaxThreshold = static_cast<T>(threshold);
+  const T kMinThreshold = static_cast<T>(-threshold);
+
+  std::vector<T> col_max(cols), col_min(cols);
+  std::vector<std::uint8_t> is_extremum(cols);
+  const cv::Mat* slices[3] = {&prev, &curr, &next};
+
+  for (int r = 1; r < rows - 1; ++r) {
+    const T* src[9];
+    for (int s = 0; s < 3; ++s) {
+      for (int dr = -1; dr <= 1; ++dr) {
+        src[3 * s + dr + 1] = slices[s]->ptr<T>(r + dr);
+      }
+    }
+    const T* center = curr.ptr<T>(r);
+
+    // Vertical pass.
+    if (find_maxima) {
+      for (int c = 0; c < cols; ++c) {
+        T m = src[0][c];
+        for (int k = 1; k < 9; ++k) m = std::max(m, src[k][c]);
+        col_max[c] = m;
+      }
+    }
+    if (find_minima) {
+      for (int c = 0; c < cols; ++c) {
+        T m = src[0][c];
+        for (int k = 1; k < 9; ++k) m = std::min(m, src[k][c]);
+        col_min[c] = m;
+      }
+    }
+
+    // Horizontal pass. The center itself is one of the 27 values, hence it is
+    // an extremum iff it equals the reduced value.
+    std::fill(is_extremum.begin(), is_extremum.end(), 0);
+    if (find_maxima) {
+      for (int c = 1; c < cols - 1; ++c) {
+        const T m = std::max(std::max(col_max[c - 1], col_max[c]),
+                             col_max[c + 1]);
+        is_extremum[c] |= (center[c] >= m) & (center[c] >= kMaxThreshold);
+      }
+    }
+    if (find_minima) {
+      for (int c = 1; c < cols - 1; ++c) {
+        const T m = std::min(std::min(col_min[c - 1], col_min[c]),
+                             col_min[c + 1]);
+        is_extremum[c] |= (center[c] <= m) & (center[c] <= kMinThreshold);
+      }
+    }
+
+    for (int c = 1; c < cols - 1; ++c) {
+      if (is_extremum[c]) extrema->emplace_back(c, r);
+    }
+  }
+}
+
+//@brief Find the extrema both in scale and space of the DoGs of one octave.
+//! The slices are visited with a sliding three-slice window, and the first and
+//! last slices are only used as neighbours.
+//@param DoG Difference of Gaussians of one octave as computed by ComputeDoGs.
+//@param threshold Extrema whose absolute value is below it are discarded.
+//@param extremum_type One of ExtremumType. Use MAXIMA for absolute DoGs.
+//@return [3 x n] coordinate matrix where keypoints are stored column by
+// column. The coordinates are 3D vectors where the first two dimensions are row
+// and col coordinates and the last dimension corresponds to scale. The order
+// is the one of arma::find on the cube.
+arma::umat FindExtrema(const arma::cube& DoG, const double threshold,
+                       const int extremum_type = uzh::MAXIMA) {
+  std::vector<arma::uword> coordinates;
+  std::vector<cv::Point2i> extrema;
+  // Column-major slices are viewed as row-major [n_cols x n_rows] matrices,
+  // i.e. their transposes, without copying. The views are only read.
+  auto slice_view = [&DoG](const int s) {
+    return cv::Mat(static_cast<int>(DoG.n_cols), static_cast<int>(DoG.n_rows),
+                   CV_64F, const_cast<double*>(DoG.slice_memptr(s)));
+  };
+  for (int s = 1; s + 1 < static_cast<int>(DoG.n_slices); ++s) {
+    extrema.clear();
+    uzh::FindExtremaInSlice<double>(slice_view(s - 1), slice_view(s),
+                                    slice_view(s + 1), threshold,
+                                    extremum_type, &extrema);
+    // Swap back the coordinates of the transposed view.
+    for (const cv::Point2i& e : extrema) {
+      coordinates.insert(coordinates.end(),
+                         {static_cast<arma::uword>(e.x),
+                          static_cast<arma::uword>(e.y),
+                          static_cast<arma::uword>(s)});
+    }
+  }
+  if (coordinates.empty()) return arma::umat(3, 0);
+  return arma::umat(coordinates.data(), 3, coordinates.size() / 3);
+}
+
+//@brief Overload of FindExtrema for the float32 DoGs of one octave of the
+// scale space, see ComputeDoGs. The keypoints are in row-major order.
+arma::umat FindExtrema(const uzh::ScaleSpaceOctave& DoG,
+                       const double threshold,
+                       const int extremum_type = uzh::MAXIMA_AND_MINIMA) {
+  std::vector<arma::uword> coordinates;
+  std::vector<cv::Point2i> extrema;
+  for (int s = 1; s + 1 < DoG.num_images; ++s) {
+    extrema.clear();
+    uzh::FindExtremaInSlice<float>(DoG.image(s - 1), DoG.image(s),
+                                   DoG.image(s + 1), threshold, extremum_type,
+                                   &extrema);
+    for (const cv::Point2i& e : extrema) {
+      coordinates.insert(coordinates.end(),
+                         {static_cast<arma::uword>(e.y),
+                          static_cast<arma::uword>(e.x),
+                          static_cast<arma::uword>(s)});
+    }
+  }
+  if (coordinates.empty()) return arma::umat(3, 0);
+  return arma::umat(coordinates.data(), 3, coordinates.size() / 3);
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_FIND_EXTREMA_H_
@@ -0,0 +1,83 @@
+#ifndef UZH_SIFT_GRADIENT_CACHE_H_
+#define UZH_SIFT_GRADIENT_CACHE_H_
+
+#include <memory>
+#include <mutex>  // std::once_flag, std::call_once
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "matlab_port/imgradient.h"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+namespace uzh {
+
+//@brief Float32 counterpart of imgradient for a row-major single channel
+// image, i.e. the Sobel gradient magnitude and the direction in degrees in
+// (-180, 180], computed without converting to arma::mat.
+inline void ComputeSliceGradient(const cv::Mat& image, cv::Mat& magnitude,
+                                 cv::Mat& direction) {
+  cv::Mat grad_x, grad_y;
+  cv::Sobel(image, grad_x, CV_32F, 1, 0, 3, 1.0, 0.0, cv::BORDER_REPLICATE);
+  cv::Sobel(image, grad_y, CV_32F, 0, 1, 3, 1.0, 0.0, cv::BORDER_REPLICATE);
+  //! cv::cartToPolar returns angles in [0, 360), which are mapped to the range
+  //! of atan2 as used by imgradient.
+  cv::cartToPolar(grad_x, grad_y, magnitude, direction, true);
+  for (int r = 0; r < direction.rows; ++r) {
+    float* row = direction.ptr<float>(r);
+    for (int c = 0; c < direction.cols; ++c) {
+      if (row[c] > 180.0f) row[c] -= 360.0f;
+    }
+  }
+}
+
+//@brief Lazily computed gradients of the blurred images of all octaves.
+//! The gradient magnitude and direction of a scale slice are computed the first
+//! time a keypoint on that slice needs them, and are then shared by the
+//! orientation assignment and the descriptor, hence neither of them causes an
+//! extra pass over the image. Slices without keypoints are never processed.
+//! Get is thread-safe, such that the octaves and slices can be described
+//! concurrently.
+class GradientCache {
+ public:
+  //@param blurred_images Blurred images computed from ComputeBlurredImages.
+  // They are referenced rather than copied and must outlive the cache.
+  explicit GradientCache(const arma::field<arma::cube>& blurred_images)
+      : blurred_images_(blurred_images),
+        offsets_(blurred_images.size() + 1, 0) {
+    for (arma::uword o = 0; o < blurred_images.size(); ++o)
+      offsets_[o + 1] = offsets_[o] + blurred_images(o).n_slices;
+    entries_ = std::make_unique<Entry[]>(offsets_.back());
+  }
+
+  //@brief Return the gradient of the slice-th image in the octave-th octave,
+  // i.e. a field containing the magnitude and the direction in degrees as
+  // returned by imgradient.
+  const arma::field<arma::mat>& Get(const int octave, const int slice) {
+    if (octave < 0 || octave >= static_cast<int>(blurred_images_.size()) ||
+        slice < 0 ||
+        slice >= static_cast<int>(blurred_images_(octave).n_slices))
+      LOG(ERROR) << "Invalid octave or slice index.";
+    Entry& entry = entries_[offsets_[octave] + slice];
+    std::call_once(entry.flag, [&] {
+      entry.gradient = uzh::imgradient(blurred_images_(octave).slice(slice));
+    });
+    return entry.gradient;
+  }
+
+ private:
+  struct Entry {
+    std::once_flag flag;
+    arma::field<arma::mat> gradient;
+  };
+
+  const arma::field<arma::cube>& blurred_images_;
+  // Index of the first entry of each octave.
+  std::vector<int> offsets_;
+  std::unique_ptr<Entry[]> entries_;
+};
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_GRADIENT_CACHE_H_
@@ -0,0 +1,203 @@
+#ifndef UZH_SIFT_HOG_DESCRIPTOR_H_
+#define UZH_SIFT_HOG_DESCRIPTOR_H_
+
+#include <array>
+#include <cmath>
+
+#include "armadillo"
+#include "sift/derotate.h"
+#include "transfer/view.h"
+
+namespace uzh {
+
+// Length of the SIFT descriptor: 4 x 4 cells times 8 orientation bins.
+constexpr int kSIFTDescriptorLength = 128;
+
+//@brief Return true if the 16 x 16 patch around the keypoint at (row, col) is
+// within the image boundary of size n_rows x n_cols.
+//! The patch is 16 x 16, so we take the point 8 pixels away from the upper
+//! left and 7 pixels aways from the lower right as the anchor point.
+inline bool IsDescribable(const int row, const int col, const int n_rows,
+                          const int n_cols) {
+  return row >= 8 && col >= 8 && row < n_rows - 15 && col < n_cols - 15;
+}
+
+//@brief Gaussian window weighting the gradient magnitudes, evaluated at
+// (r, c) as SIFTWindowWeight(r) * SIFTWindowWeight(c), where r and c are the
+// possibly fractional sample coordinates in the 16 x 16 patch.
+//! Same as uzh::fspecial(uzh::GAUSSIAN, 16, 16.0 * 1.5) at integer coordinates,
+//! but evaluated analytically rather than built per call. The magic number 1.5
+//! is taken from Lowe's paper.
+inline double SIFTWindowWeight(const double x) {
+  const double kSigma = 16.0 * 1.5;
+  static const double kNormalizer = [kSigma] {
+    double sum = 0.0;
+    for (int i = 0; i < 16; ++i) {
+      sum += std::exp(-(i - 7.5) * (i - 7.5) / (2 * kSigma * kSigma));
+    }
+    return sum;
+  }();
+  return std::exp(-(x - 7.5) * (x - 7.5) / (2 * kSigma * kSigma)) /
+         kNormalizer;
+}
+
+//@brief SIFTWindowWeight at the integer coordinates 0, ..., 15.
+inline const std::array<double, 16>& SIFTWindowWeights() {
+  static const std::array<double, 16> weights = [] {
+    std::array<double, 16> w;
+    for (int i = 0; i < 16; ++i) w[i] = SIFTWindowWeight(i);
+    return w;
+  }();
+  return weights;
+}
+
+//@brief Add the vote of one sample to the histograms of the descriptor.
+//@param r, c Coordinates of the sample in the 16 x 16 patch, in [-0.5, 15.5).
+//@param bin Continuous orientation bin in [0, 8).
+//@param magnitude Weighted gradient magnitude of the sample.
+inline void VoteHOGDescriptor(const double r, const double c, const double bin,
+                              const double magnitude, const bool trilinear,
+                              double* hist) {
+  if (!trilinear) {
+    const int sample_row = static_cast<int>(r + 0.5);
+    const int sample_col = static_cast<int>(c + 0.5);
+    //! & 7 wraps bin 8, i.e. 180 degrees, to bin 0.
+    const int o = static_cast<int>(bin) & 7;
+    hist[8 * (4 * (sample_row / 4) + sample_col / 4) + o] += magnitude;
+    return;
+  }
+
+  // Coordinates relative to the centers of the cells and of the bins.
+  const double rb = (r + 0.5) / 4.0 - 0.5;
+  const double cb = (c + 0.5) / 4.0 - 0.5;
+  const double ob = bin - 0.5;
+  const int r0 = static_cast<int>(std::floor(rb));
+  const int c0 = static_cast<int>(std::floor(cb));
+  const int o0 = static_cast<int>(std::floor(ob));
+  const double dr = rb - r0, dc = cb - c0, dob = ob - o0;
+  for (int i = 0; i < 2; ++i) {
+    const int cell_row = r0 + i;
+    if (cell_row < 0 || cell_row > 3) continue;
+    const double w_r = magnitude * (i == 0 ? 1.0 - dr : dr);
+    for (int j = 0; j < 2; ++j) {
+      const int cell_col = c0 + j;
+      if (cell_col < 0 || cell_col > 3) continue;
+      const double w_rc = w_r * (j == 0 ? 1.0 - dc : dc);
+      double* cell_hist = hist + 8 * (4 * cell_row + cell_col);
+      //! Orientations are circular: & 7 maps -1 to 7 and 8 to 0.
+      cell_hist[o0 & 7] += w_rc * (1.0 - dob);
+      cell_hist[(o0 + 1) & 7] += w_rc * dob;
+    }
+  }
+}
+
+//@brief Compute the 128 dimensional Histogram of Oriented Gradients descriptor
+// of the keypoint at (row, col) in a single pass over the 256 samples of the
+// 16 x 16 patch. The keypoint must be describable.
+//! The patch is divided into 4 x 4 cells of 4 x 4 samples. The histogram of the
+//! cell in the j-th row block and the i-th col block occupies the entries
+//! [8 * (4 * j + i), 8 * (4 * j + i) + 8) of the descriptor. The bins are 45
+//! degrees wide and start at -180 degrees, and 180 degrees wraps to bin 0.
+//! Instead of searching the bin edges, the bin of a sample is computed
+//! arithmetically.
+//@param grad_magnitude Gradient magnitude of the image the keypoint lies on.
+//@param grad_direction Gradient direction in degrees in [-180, 180] of the
+// same image.
+//@param row Row index of the keypoint.
+//@param col Col index of the keypoint.
+//@param trilinear If false, each sample votes for its own cell and bin only.
+// If true, the vote is distributed to the 2 x 2 x 2 neighbouring cells and
+// bins with trilinear interpolation weights, as suggested by Lowe.
+//@param descriptor Output buffer of length 128. The descriptor is not
+// normalized.
+//@param orientation Dominant orientation of the keypoint in degrees, see
+// ComputeDominantOrientation. If non-zero, the patch is derotated by it: the
+// pixels around the keypoint are mapped into the frame of the keypoint and
+// their gradient directions are taken relative to it. The pixels mapped
+// outside of the image are skipped.
+template <typename T, typename U>
+void ComputeHOGDescriptor(const uzh::StridedView<T>& grad_magnitude,
+                          const uzh::StridedView<T>& grad_direction,
+                          const int row, const int col, const bool trilinear,
+                          U* descriptor, const double orientation = 0.0) {
+  double hist[kSIFTDescriptorLength] = {};
+
+  if (orientation == 0.0) {
+    const std::array<double, 16>& weights = SIFTWindowWeights();
+    for (int r = 0; r < 16; ++r) {
+      for (int c = 0; c < 16; ++c) {
+        const double magnitude = grad_magnitude(row - 8 + r, col - 8 + c) *
+                                 weights[r] * weights[c];
+        // Continuous orientation bin in [0, 8].
+        const double bin =
+            (grad_direction(row - 8 + r, col - 8 + c) + 180.0) / 45.0;
+        VoteHOGDescriptor(r, c, bin, magnitude, trilinear, hist);
+      }
+    }
+  } else {
+    const double kTheta = orientation * arma::datum::pi / 180.0;
+    const double kCos = std::cos(kTheta), kSin = std::sin(kTheta);
+    // The derotated 16 x 16 patch fits in a square of radius 8 * sqrt(2).
+    const int kRadius = 12;
+    for (int dr = -kRadius; dr <= kRadius; ++dr) {
+      const int y = row + dr;
+      if (y < 0 || y >= grad_magnitude.rows) continue;
+      for (int dc = -kRadius; dc <= kRadius; ++dc) {
+        const int x = col + dc;
+        if (x < 0 || x >= grad_magnitude.cols) continue;
+        // Coordinates in the frame of the keypoint, which lies at (8, 8) of
+        // the patch as in the axis-aligned case.
+        const double r = -kSin * dc + kCos * dr + 8.0;
+        const double c = kCos * dc + kSin * dr + 8.0;
+        if (r < -0.5 || r >= 15.5 || c < -0.5 || c >= 15.5) continue;
+        const double magnitude =
+            grad_magnitude(y, x) * SIFTWindowWeight(r) * SIFTWindowWeight(c);
+        double bin = (grad_direction(y, x) - orientation + 180.0) / 45.0;
+        bin = std::fmod(bin, 8.0);
+        if (bin < 0) bin += 8.0;
+        VoteHOGDescriptor(r, c, bin, magnitude, trilinear, hist);
+      }
+    }
+  }
+
+  for (int k = 0; k < kSIFTDescriptorLength; ++k) {
+    descriptor[k] = static_cast<U>(hist[k]);
+  }
+}
+
+//@brief Compute the descriptors of a batch of keypoints lying on the same
+// scale slice, such that the gradients of that slice stay in cache.
+//@param keypoints_2d [2 x n] matrix of the (row, col) coordinates of the
+// keypoints.
+//@param rotation_invariant If true, the dominant orientation of each keypoint
+// is computed from the same gradients and the patch is derotated by it.
+//@param descriptors Output buffer. The descriptors of the describable keypoints
+// are written consecutively, each taking 128 entries, while the others are
+// skipped.
+//@return The number of descriptors written.
+template <typename T, typename U>
+int ComputeHOGDescriptors(const uzh::StridedView<T>& grad_magnitude,
+                          const uzh::StridedView<T>& grad_direction,
+                          const arma::umat& keypoints_2d,
+                          const bool rotation_invariant, const bool trilinear,
+                          U* descriptors) {
+  int num_described = 0;
+  for (arma::uword k = 0; k < keypoints_2d.n_cols; ++k) {
+    const int row = keypoints_2d(0, k), col = keypoints_2d(1, k);
+    if (!IsDescribable(row, col, grad_magnitude.rows, grad_magnitude.cols))
+      continue;
+    const double orientation =
+        rotation_invariant ? uzh::ComputeDominantOrientation(
+                                 grad_magnitude, grad_direction, row, col)
+                           : 0.0;
+    ComputeHOGDescriptor(grad_magnitude, grad_direction, row, col, trilinear,
+                         descriptors + num_described * kSIFTDescriptorLength,
+                         orientation);
+    ++num_described;
+  }
+  return num_described;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_HOG_DESCRIPTOR_H_
@@ -0,0 +1,194 @@
+#ifndef UZH_SIFT_PARALLEL_SIFT_H_
+#define UZH_SIFT_PARALLEL_SIFT_H_
+
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "opencv2/core.hpp"
+#include "parallel/thread_pool.h"
+#include "sift/compute_blurred_images.h"
+#include "sift/compute_descriptors.h"
+#include "sift/compute_image_pyramid.h"
+#include "sift/extract_keypoints.h"
+#include "sift/gradient_cache.h"
+#include "sift/hog_descriptor.h"
+#include "sift/refine_keypoints.h"
+#include "sift/sift_parameters.h"
+#include "transfer/view.h"
+
+namespace uzh {
+
+//@brief Run the SIFT pipeline, i.e. ComputeImagePyramid, ComputeBlurredImages,
+// ComputeDoGs, ExtractKeypoints and ComputeDescriptors, on a thread pool.
+//! After the image pyramid is built, the octaves are independent. Each
+//! (octave, scale slice) pair is scheduled as a task for blurring, computing
+//! DoGs and describing keypoints, and each octave as a task for extracting
+//! keypoints. The descriptors and keypoints are written straight into the
+//! returned matrices at precomputed offsets, in the same order as the
+//! sequential pipeline produces them.
+//@param image Image to be processed.
+//@param params SIFT settings. If params.refine_keypoints, the extracted
+// keypoints are refined and filtered by RefineOctaveKeypoints in the task of
+// their octave, before any of them is described. The keypoints are extracted
+// from the absolute DoGs and refined on the signed ones.
+//@param pool Thread pool on which the tasks are run. Being re-entrant, the
+// pool can be shared by concurrent calls, e.g. one per image.
+//@param stats If not nullptr, the counts of the keypoint refinement are
+// accumulated into it.
+//@return descriptors -- [128 x n] matrix where each column is a normalized
+// descriptor; keypoints -- [2 x n] matrix where each column contains the (row,
+// col) coordinates of the keypoint in the original image.
+std::tuple<arma::mat /*descriptors*/, arma::umat /*keypoints*/> ParallelSIFT(
+    const cv::Mat& image, const uzh::SIFTParameters& params,
+    uzh::ThreadPool& pool = uzh::ThreadPool::Global(),
+    uzh::KeypointFilterStats* stats = nullptr) {
+  const int num_octaves = params.num_octaves;
+  const int num_scales = params.num_scales;
+  const double base_sigma = params.base_sigma;
+  const double keypoints_threshold = params.keypoints_threshold;
+  const bool rotation_invariant = params.rotation_invariant;
+  const bool trilinear = params.trilinear;
+  if (image.empty()) LOG(ERROR) << "Empty input image.";
+
+  const arma::field<cv::Mat> image_pyramid =
+      uzh::ComputeImagePyramid(image, num_octaves);
+  const int kImagesPerOctave = num_scales + 3;
+  const int kDoGsPerOctave = kImagesPerOctave - 1;
+
+  // Blur each (octave, scale) image into preallocated cubes.
+  arma::field<arma::cube> blurred_images(num_octaves);
+  arma::field<arma::cube> DoGs(num_octaves);
+  for (int o = 0; o < num_octaves; ++o) {
+    blurred_images(o).set_size(image_pyramid(o).rows, image_pyramid(o).cols,
+                               kImagesPerOctave);
+    DoGs(o).set_size(image_pyramid(o).rows, image_pyramid(o).cols,
+                     kDoGsPerOctave);
+  }
+  pool.ParallelFor(0, num_octaves * kImagesPerOctave, [&](const int t) {
+    const int o = t / kImagesPerOctave, i = t % kImagesPerOctave;
+    blurred_images(o).slice(i) =
+        uzh::ComputeBlurredImage(image_pyramid(o), i, num_scales, base_sigma);
+  });
+  // Compute each (octave, scale) signed DoG, as ComputeDoGs with absolute
+  // false, which is what RefineOctaveKeypoints fits.
+  pool.ParallelFor(0, num_octaves * kDoGsPerOctave, [&](const int t) {
+    const int o = t / kDoGsPerOctave, d = t % kDoGsPerOctave;
+    DoGs(o).slice(d) =
+        blurred_images(o).slice(d + 1) - blurred_images(o).slice(d);
+  });
+  // Extract keypoints of each octave.
+  arma::field<arma::umat> octave_keypoints(num_octaves);
+  std::vector<uzh::KeypointFilterStats> octave_stats(num_octaves);
+  pool.ParallelFor(0, num_octaves, [&](const int o) {
+    // Both the maxima and the minima are found as maxima of the absolute DoGs.
+    octave_keypoints(o) =
+        uzh::ExtractOctaveKeypoints(arma::abs(DoGs(o)), keypoints_threshold);
+    if (params.refine_keypoints) {
+      octave_keypoints(o) = uzh::RefineOctaveKeypoints(
+          DoGs(o), octave_keypoints(o), params.contrast_threshold,
+          params.edge_ratio, &octave_stats[o]);
+    }
+  });
+  if (stats != nullptr) {
+    for (const uzh::KeypointFilterStats& s : octave_stats) *stats += s;
+  }
+
+  // Group keypoints by the slice they lie on, and count the describable ones
+  // to lay out the output.
+  struct SliceJob {
+    int octave;
+    int slice;
+    arma::umat keypoints_2d;
+    int offset;
+  };
+  std::vector<SliceJob> jobs;
+  int num_describable = 0;
+  for (int o = 0; o < num_octaves; ++o) {
+    const arma::umat& oct_keypoints = octave_keypoints(o);
+    if (oct_keypoints.empty()) continue;
+    const arma::urowvec kImageIndices = arma::unique(oct_keypoints.row(2));
+    for (const arma::uword img_idx : kImageIndices) {
+      const arma::umat kept_keypoints_2d =
+          oct_keypoints.cols(arma::find(oct_keypoints.row(2) == img_idx))
+              .eval()
+              .head_rows(2);
+      jobs.push_back({o, static_cast<int>(img_idx), kept_keypoints_2d,
+                      num_describable});
+      for (arma::uword k = 0; k < kept_keypoints_2d.n_cols; ++k) {
+        if (uzh::IsDescribable(kept_keypoints_2d(0, k), kept_keypoints_2d(1, k),
+                               image_pyramid(o).rows, image_pyramid(o).cols))
+          ++num_describable;
+      }
+    }
+  }
+
+  uzh::GradientCache gradient_cache(blurred_images);
+  arma::mat descriptors(uzh::kSIFTDescriptorLength, num_describable,
+                        arma::fill::zeros);
+  arma::umat keypoints(2, num_describable);
+  pool.ParallelFor(0, static_cast<int>(jobs.size()), [&](const int j) {
+    const SliceJob& job = jobs[j];
+    const arma::field<arma::mat>& gradient =
+        gradient_cache.Get(job.octave, job.slice);
+    const int kScale = 1 << job.octave;
+    // All keypoints of the slice are described in one batch.
+    uzh::ComputeHOGDescriptors(uzh::strided_view(gradient(0)),
+                               uzh::strided_view(gradient(1)),
+                               job.keypoints_2d, rotation_invariant,
+                               trilinear, descriptors.colptr(job.offset));
+    int c = job.offset;
+    for (arma::uword k = 0; k < job.keypoints_2d.n_cols; ++k) {
+      const int row = job.keypoints_2d(0, k), col = job.keypoints_2d(1, k);
+      if (!uzh::IsDescribable(row, col, gradient(0).n_rows,
+                              gradient(0).n_cols))
+        continue;
+      // Normalize the descriptor to unit Euclidean norm.
+      const double norm = arma::norm(descriptors.col(c));
+      if (norm > 0) descriptors.col(c) /= norm;
+      // Map the coordinates back to the original image resolution.
+      keypoints(0, c) = row * kScale;
+      keypoints(1, c) = col * kScale;
+      ++c;
+    }
+  });
+
+  return {descriptors, keypoints};
+}
+
+//@brief Overloaded with the settings passed one by one, see SIFTParameters.
+//@param image Image to be processed.
+//@param num_octaves Number of octaves of the image pyramid.
+//@param num_scales Number of scales per octave.
+//@param base_sigma Base sigma used to generate the Gaussians.
+//@param keypoints_threshold Below which the points are suppressed.
+//@param rotation_invariant Whether the patches are derotated by the dominant
+// orientation of the keypoints, see ComputeDominantOrientation.
+//@param trilinear Whether the gradients are binned with trilinear
+// interpolation, see ComputeHOGDescriptor.
+//@param pool Thread pool on which the tasks are run.
+//@param refine_keypoints Whether the keypoints are refined and filtered, see
+// SIFTParameters. Off by default, unlike in SIFTParameters, such that the
+// callers of this overload keep their keypoints.
+std::tuple<arma::mat /*descriptors*/, arma::umat /*keypoints*/> ParallelSIFT(
+    const cv::Mat& image, const int num_octaves, const int num_scales,
+    const double base_sigma, const double keypoints_threshold,
+    const bool rotation_invariant = false, const bool trilinear = false,
+    uzh::ThreadPool& pool = uzh::ThreadPool::Global(),
+    const bool refine_keypoints = false) {
+  uzh::SIFTParameters params;
+  params.num_octaves = num_octaves;
+  params.num_scales = num_scales;
+  params.base_sigma = base_sigma;
+  params.keypoints_threshold = keypoints_threshold;
+  params.rotation_invariant = rotation_invariant;
+  params.trilinear = trilinear;
+  params.refine_keypoints = refine_keypoints;
+  return ParallelSIFT(image, params, pool);
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_PARALLEL_SIFT_H_
@@ -0,0 +1,67 @@
+#ifndef UZH_SIFT_QUANTIZE_DESCRIPTORS_H_
+#define UZH_SIFT_QUANTIZE_DESCRIPTORS_H_
+
+#include <algorithm>  // std::min
+#include <cmath>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "sift/hog_descriptor.h"
+
+namespace uzh {
+
+// Entries of a normalized descriptor are clamped at this value to reduce the
+// influence of large gradient magnitudes, following Lowe.
+constexpr double kSIFTDescriptorClamp = 0.2;
+// After renormalization no entry exceeds kSIFTDescriptorClamp by much, hence
+// scaling by 512 spans the range of uint8 with little saturation.
+constexpr double kSIFTQuantizationScale = 512.0;
+
+//@brief Quantize a SIFT descriptor to 128 bytes.
+//! The descriptor is normalized, clamped at kSIFTDescriptorClamp, renormalized,
+//! scaled by kSIFTQuantizationScale and saturated to [0, 255].
+//@param descriptor 128 non-negative entries, not necessarily normalized.
+//@param quantized Output 128 bytes.
+template <typename T>
+void QuantizeSIFTDescriptor(const T* descriptor, unsigned char* quantized) {
+  double norm = 0.0;
+  for (int k = 0; k < uzh::kSIFTDescriptorLength; ++k)
+    norm += descriptor[k] * descriptor[k];
+  norm = std::sqrt(norm);
+
+  double clamped[uzh::kSIFTDescriptorLength];
+  double clamped_norm = 0.0;
+  for (int k = 0; k < uzh::kSIFTDescriptorLength; ++k) {
+    clamped[k] =
+        norm > 0 ? std::min(descriptor[k] / norm, kSIFTDescriptorClamp) : 0.0;
+    clamped_norm += clamped[k] * clamped[k];
+  }
+  clamped_norm = std::sqrt(clamped_norm);
+
+  const double kScale =
+      clamped_norm > 0 ? kSIFTQuantizationScale / clamped_norm : 0.0;
+  for (int k = 0; k < uzh::kSIFTDescriptorLength; ++k) {
+    quantized[k] = static_cast<unsigned char>(
+        std::min(255.0, std::round(clamped[k] * kScale)));
+  }
+}
+
+//@brief Quantize SIFT descriptors to uint8, 128 bytes per descriptor rather
+// than 1 KB for double.
+//@param descriptors [128 x n] matrix where each column is a descriptor, e.g.
+// from ComputeDescriptors.
+//@return [128 x n] matrix where each column is a quantized descriptor. Since
+// armadillo is column-major, the bytes of each descriptor are contiguous.
+arma::Mat<unsigned char> QuantizeSIFTDescriptors(const arma::mat& descriptors) {
+  if (descriptors.n_rows != uzh::kSIFTDescriptorLength)
+    LOG(ERROR) << "descriptors must be a [128 x n] matrix.";
+
+  arma::Mat<unsigned char> quantized(descriptors.n_rows, descriptors.n_cols);
+  for (arma::uword i = 0; i < descriptors.n_cols; ++i)
+    QuantizeSIFTDescriptor(descriptors.colptr(i), quantized.colptr(i));
+  return quantized;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_QUANTIZE_DESCRIPTORS_H_
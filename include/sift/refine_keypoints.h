@@ -0,0 +1,223 @@
+#ifndef UZH_SIFT_REFINE_KEYPOINTS_H_
+#define UZH_SIFT_REFINE_KEYPOINTS_H_
+
+#include <cmath>
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+
+namespace uzh {
+
+//@brief Outcome of RefineKeypoint.
+enum KeypointStability : int {
+  KEYPOINT_STABLE,
+  KEYPOINT_UNSTABLE,      // The quadratic fit diverges or leaves the DoGs.
+  KEYPOINT_LOW_CONTRAST,  // The interpolated DoG value is too small.
+  KEYPOINT_EDGE           // The principal curvatures are too different.
+};
+
+// Number of times the sample point may be moved to a neighbour during the
+// subpixel refinement, i.e. the farthest a kept keypoint may end up from the
+// extremum it started from.
+constexpr int kSIFTMaxRefinementSteps = 4;
+
+//@brief Number of candidates removed by each stage of RefineKeypoints.
+struct KeypointFilterStats {
+  int num_candidates = 0;
+  int num_unstable = 0;
+  int num_low_contrast = 0;
+  int num_edge = 0;
+
+  int num_kept() const {
+    return num_candidates - num_unstable - num_low_contrast - num_edge;
+  }
+
+  void Add(const KeypointStability stability) {
+    ++num_candidates;
+    if (stability == KEYPOINT_UNSTABLE) ++num_unstable;
+    if (stability == KEYPOINT_LOW_CONTRAST) ++num_low_contrast;
+    if (stability == KEYPOINT_EDGE) ++num_edge;
+  }
+
+  KeypointFilterStats& operator+=(const KeypointFilterStats& other) {
+    num_candidates += other.num_candidates;
+    num_unstable += other.num_unstable;
+    num_low_contrast += other.num_low_contrast;
+    num_edge += other.num_edge;
+    return *this;
+  }
+};
+
+//@brief Refine an extremum of the DoGs by fitting a 3D quadratic to its
+// 3 x 3 x 3 neighbourhood and test whether it is stable, following Lowe.
+//! The derivatives are approximated by central differences and the offset of
+//! the extremum of the quadratic is -H^-1 * g. If the offset exceeds 0.5 in
+//! some dimension, the sample point is moved to that neighbour and the fit
+//! repeated, at most kSIFTMaxRefinementSteps times. Then,
+//! - the extremum is of low contrast if the absolute interpolated value
+//!   D + 0.5 * g' * offset is below contrast_threshold;
+//! - the extremum lies on an edge if the ratio of the principal curvatures of
+//!   the spatial 2 x 2 Hessian exceeds edge_ratio, which is tested as
+//!   tr^2 / det >= (r + 1)^2 / r without computing the eigenvalues.
+//! Only the DoG values already in memory are read, hence this is much
+//! cheaper than computing a descriptor.
+//@param D Callable D(slice, row, col) returning the DoG value.
+//@param min_slice Smallest slice the sample point may be at. Slices
+// min_slice - 1 to max_slice + 1 must be accessible through D.
+//@param max_slice Largest slice the sample point may be at.
+//@param rows Number of rows of the DoGs.
+//@param cols Number of cols of the DoGs.
+//@param contrast_threshold Below which the interpolated extrema are rejected.
+//@param edge_ratio Above which the ratios of curvatures are rejected.
+//@param slice Slice of the extremum, moved with the sample point.
+//@param row Row of the extremum, moved with the sample point.
+//@param col Col of the extremum, moved with the sample point.
+//@return Whether the extremum is stable, or else the stage rejecting it.
+template <typename F>
+KeypointStability RefineKeypoint(const F& D, const int min_slice,
+                                 const int max_slice, const int rows,
+                                 const int cols,
+                                 const double contrast_threshold,
+                                 const double edge_ratio, int* slice, int* row,
+                                 int* col) {
+  int s = *slice, r = *row, c = *col;
+  double value = 0.0;
+  double g[3];     // Gradient w.r.t. (col, row, slice).
+  double h[3][3];  // Hessian w.r.t. (col, row, slice).
+  double offset[3];
+  for (int step = 0;; ++step) {
+    value = D(s, r, c);
+    g[0] = 0.5 * (D(s, r, c + 1) - D(s, r, c - 1));
+    g[1] = 0.5 * (D(s, r + 1, c) - D(s, r - 1, c));
+    g[2] = 0.5 * (D(s + 1, r, c) - D(s - 1, r, c));
+    h[0][0] = D(s, r, c + 1) + D(s, r, c - 1) - 2 * value;
+    h[1][1] = D(s, r + 1, c) + D(s, r - 1, c) - 2 * value;
+    h[2][2] = D(s + 1, r, c) + D(s - 1, r, c) - 2 * value;
+    h[0][1] = h[1][0] = 0.25 * (D(s, r + 1, c + 1) - D(s, r + 1, c - 1) -
+                                D(s, r - 1, c + 1) + D(s, r - 1, c - 1));
+    h[0][2] = h[2][0] = 0.25 * (D(s + 1, r, c + 1) - D(s + 1, r, c - 1) -
+                                D(s - 1, r, c + 1) + D(s - 1, r, c - 1));
+    h[1][2] = h[2][1] = 0.25 * (D(s + 1, r + 1, c) - D(s + 1, r - 1, c) -
+                                D(s - 1, r + 1, c) + D(s - 1, r - 1, c));
+
+    // Solve H * offset = -g with Cramer's rule.
+    const double kCofactor00 = h[1][1] * h[2][2] - h[1][2] * h[2][1];
+    const double kCofactor01 = h[1][2] * h[2][0] - h[1][0] * h[2][2];
+    const double kCofactor02 = h[1][0] * h[2][1] - h[1][1] * h[2][0];
+    const double kDet = h[0][0] * kCofactor00 + h[0][1] * kCofactor01 +
+                        h[0][2] * kCofactor02;
+    if (kDet == 0) return KEYPOINT_UNSTABLE;
+    //! H is symmetric, hence its adjugate is the matrix of cofactors.
+    const double kCofactor11 = h[0][0] * h[2][2] - h[0][2] * h[2][0];
+    const double kCofactor12 = h[0][1] * h[2][0] - h[0][0] * h[2][1];
+    const double kCofactor22 = h[0][0] * h[1][1] - h[0][1] * h[1][0];
+    offset[0] =
+        -(kCofactor00 * g[0] + kCofactor01 * g[1] + kCofactor02 * g[2]) / kDet;
+    offset[1] =
+        -(kCofactor01 * g[0] + kCofactor11 * g[1] + kCofactor12 * g[2]) / kDet;
+    offset[2] =
+        -(kCofactor02 * g[0] + kCofactor12 * g[1] + kCofactor22 * g[2]) / kDet;
+
+    if (std::abs(offset[0]) <= 0.5 && std::abs(offset[1]) <= 0.5 &&
+        std::abs(offset[2]) <= 0.5)
+      break;
+    if (step == kSIFTMaxRefinementSteps) return KEYPOINT_UNSTABLE;
+
+    // Move to the neighbour closest to the extremum of the quadratic.
+    //! Written such that NaN offsets are rejected as well.
+    const double kCol = c + offset[0], kRow = r + offset[1],
+                 kSlice = s + offset[2];
+    if (!(kCol >= 1 && kCol <= cols - 2 && kRow >= 1 && kRow <= rows - 2 &&
+          kSlice >= min_slice && kSlice <= max_slice))
+      return KEYPOINT_UNSTABLE;
+    c = static_cast<int>(std::lround(kCol));
+    r = static_cast<int>(std::lround(kRow));
+    s = static_cast<int>(std::lround(kSlice));
+  }
+
+  const double kInterpolatedValue =
+      value + 0.5 * (g[0] * offset[0] + g[1] * offset[1] + g[2] * offset[2]);
+  if (std::abs(kInterpolatedValue) < contrast_threshold)
+    return KEYPOINT_LOW_CONTRAST;
+
+  const double kTrace = h[0][0] + h[1][1];
+  const double kDet = h[0][0] * h[1][1] - h[0][1] * h[0][1];
+  const double kMaxRatio = (edge_ratio + 1) * (edge_ratio + 1) / edge_ratio;
+  if (kDet <= 0 || kTrace * kTrace >= kMaxRatio * kDet) return KEYPOINT_EDGE;
+
+  *slice = s;
+  *row = r;
+  *col = c;
+  return KEYPOINT_STABLE;
+}
+
+//@brief Reject the unstable, low contrast and edge-like keypoints of one
+// octave and move the remaining ones to their refined sample points, see
+// RefineKeypoint.
+//@param DoG Signed difference of Gaussians of one octave, i.e. computed with
+// absolute false. The absolute DoGs have wrong derivatives where D crosses
+// zero.
+//@param keypoints [3 x n] matrix of (row, col, scale) coordinates from
+// ExtractOctaveKeypoints.
+//@param contrast_threshold Below which the interpolated extrema are rejected.
+//@param edge_ratio Above which the ratios of curvatures are rejected.
+//@param stats If not nullptr, the counts are accumulated into it.
+//@return [3 x m] matrix of the refined (row, col, scale) coordinates of the
+// stable keypoints.
+arma::umat RefineOctaveKeypoints(const arma::cube& DoG,
+                                 const arma::umat& keypoints,
+                                 const double contrast_threshold,
+                                 const double edge_ratio,
+                                 KeypointFilterStats* stats = nullptr) {
+  if (keypoints.n_rows != 3) LOG(ERROR) << "keypoints is a [3 x n] matrix.";
+  const auto D = [&DoG](const int s, const int r, const int c) {
+    return DoG(r, c, s);
+  };
+
+  std::vector<arma::uword> refined;
+  KeypointFilterStats octave_stats;
+  for (arma::uword k = 0; k < keypoints.n_cols; ++k) {
+    int row = keypoints(0, k), col = keypoints(1, k), slice = keypoints(2, k);
+    const KeypointStability kStability = uzh::RefineKeypoint(
+        D, 1, static_cast<int>(DoG.n_slices) - 2, DoG.n_rows, DoG.n_cols,
+        contrast_threshold, edge_ratio, &slice, &row, &col);
+    octave_stats.Add(kStability);
+    if (kStability != KEYPOINT_STABLE) continue;
+    refined.push_back(row);
+    refined.push_back(col);
+    refined.push_back(slice);
+  }
+  if (stats != nullptr) *stats += octave_stats;
+
+  if (refined.empty()) return arma::umat(3, 0);
+  return arma::umat(refined.data(), 3, refined.size() / 3);
+}
+
+//@brief Reject the unstable, low contrast and edge-like keypoints of all
+// octaves. Meant to be run between ExtractKeypoints and ComputeDescriptors,
+// such that only stable keypoints are described.
+//@param DoGs Signed difference of Gaussians computed from ComputeDoGs with
+// absolute false.
+//@param keypoints Keypoints computed from ExtractKeypoints.
+//@param contrast_threshold Below which the interpolated extrema are rejected.
+//@param edge_ratio Above which the ratios of curvatures are rejected.
+//@param stats If not nullptr, the counts are accumulated into it.
+//@return The refined coordinates of the stable keypoints of all octaves.
+arma::field<arma::umat> RefineKeypoints(
+    const arma::field<arma::cube>& DoGs,
+    const arma::field<arma::umat>& keypoints, const double contrast_threshold,
+    const double edge_ratio, KeypointFilterStats* stats = nullptr) {
+  if (DoGs.size() != keypoints.size())
+    LOG(ERROR) << "The number of octaves are not consistent.";
+  arma::field<arma::umat> refined(keypoints.size());
+  for (arma::uword o = 0; o < keypoints.size(); ++o) {
+    refined(o) = RefineOctaveKeypoints(DoGs(o), keypoints(o),
+                                       contrast_threshold, edge_ratio, stats);
+  }
+  return refined;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_REFINE_KEYPOINTS_H_
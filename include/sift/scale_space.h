@@ -0,0 +1,147 @@
+#ifndef UZH_SIFT_SCALE_SPACE_H_
+#define UZH_SIFT_SCALE_SPACE_H_
+
+#include <cmath>
+#include <vector>
+
+#include "glog/logging.h"
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+namespace uzh {
+
+//@brief Gaussian blurred images of one octave stored as float32.
+//! The images are stacked vertically in one contiguous row-major buffer, i.e.
+//! image i occupies rows [i * rows, (i + 1) * rows) of data. The image
+//! headers returned by image() share the buffer, hence no copy or transpose
+//! is involved.
+struct ScaleSpaceOctave {
+  cv::Mat data;  // [(num_images * rows) x cols] CV_32F
+  int rows = 0;
+  int cols = 0;
+  int num_images = 0;
+
+  //@brief Header of the i-th blurred image, i = 0, ..., num_images - 1.
+  cv::Mat image(const int i) const {
+    return data.rowRange(i * rows, (i + 1) * rows);
+  }
+};
+
+//@brief Sigma of the i-th blurred image of an octave, relative to the
+// resolution of that octave. Identical to the one used by ComputeBlurredImage.
+inline double ScaleSpaceSigma(const int i, const int num_scales,
+                              const double base_sigma) {
+  return std::pow(2, (i - 1) / (double)num_scales) * base_sigma;
+}
+
+//@brief Radius of the Gaussian kernel used by SeparableGaussianBlur.
+//! A radius of 4 sigma is used by cv::GaussianBlur for floating point images.
+inline int GaussianKernelRadius(const double sigma) {
+  return static_cast<int>(std::ceil(4 * sigma));
+}
+
+//@brief Blur src with a separable float32 Gaussian kernel and write the result
+// to dst, which must be preallocated with the same size as src.
+//! src is blurred as a standalone image even if it is an ROI, i.e. the pixels
+//! outside of it are not read.
+inline void SeparableGaussianBlur(const cv::Mat& src, cv::Mat dst,
+                                  const double sigma) {
+  const int kKernelSize = 2 * GaussianKernelRadius(sigma) + 1;
+  const cv::Mat kernel = cv::getGaussianKernel(kKernelSize, sigma, CV_32F);
+  //! dst is a header into preallocated storage. Since its size and type match,
+  //! cv::sepFilter2D writes into it rather than reallocating.
+  cv::sepFilter2D(src, dst, CV_32F, kernel, kernel, cv::Point(-1, -1), 0.0,
+                  cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+}
+
+//@brief Sigmas with which the images of an octave are blurred incrementally.
+//! The 0-th one blurs the base image of the octave, and the i-th one blurs the
+//! (i-1)-th image to the i-th, i.e. sqrt(sigma_i^2 - sigma_{i-1}^2).
+inline std::vector<double> IncrementalSigmas(const int num_scales,
+                                             const double base_sigma) {
+  const int kImagesPerOctave = num_scales + 3;
+  std::vector<double> incremental_sigmas(kImagesPerOctave);
+  incremental_sigmas[0] = ScaleSpaceSigma(0, num_scales, base_sigma);
+  for (int i = 1; i < kImagesPerOctave; ++i) {
+    const double sigma_prev = ScaleSpaceSigma(i - 1, num_scales, base_sigma);
+    const double sigma_curr = ScaleSpaceSigma(i, num_scales, base_sigma);
+    incremental_sigmas[i] =
+        std::sqrt(sigma_curr * sigma_curr - sigma_prev * sigma_prev);
+  }
+  return incremental_sigmas;
+}
+
+//@brief Take every second pixel of src and write them to dst, which must be
+// preallocated with size ((src.rows + 1) / 2) x ((src.cols + 1) / 2).
+inline void DecimateByTwo(const cv::Mat& src, cv::Mat dst) {
+  for (int r = 0; r < dst.rows; ++r) {
+    const float* src_row = src.ptr<float>(2 * r);
+    float* dst_row = dst.ptr<float>(r);
+    for (int c = 0; c < dst.cols; ++c) dst_row[c] = src_row[2 * c];
+  }
+}
+
+//@brief Compute the Gaussian scale space of an image incrementally.
+//! Unlike ComputeImagePyramid + ComputeBlurredImages which blur each octave
+//! image from scratch with the full sigma, this follows Lowe's scheme:
+//! - The i-th image is obtained by blurring the (i-1)-th image with the
+//!   incremental sigma sqrt(sigma_i^2 - sigma_{i-1}^2), which is much smaller
+//!   and hence has a much shorter kernel.
+//! - The image with index num_scales has twice the sigma of the first image.
+//!   Taking every second pixel of it yields the first image of the next
+//!   octave, which is therefore not blurred again.
+//@param image Image to be processed. It is converted to float32 but not
+// rescaled, i.e. a double image in [0, 1] stays in [0, 1].
+//@param num_octaves Number of octaves.
+//@param num_scales Number of scales per octave. Each octave contains
+// num_scales + 3 blurred images.
+//@param base_sigma Base sigma from which the sigmas are generated.
+//@return The blurred images of all octaves.
+std::vector<ScaleSpaceOctave> ComputeScaleSpace(const cv::Mat& image,
+                                                const int num_octaves,
+                                                const int num_scales,
+                                                const double base_sigma) {
+  if (image.empty()) LOG(ERROR) << "Empty input image.";
+  if (image.channels() != 1) LOG(ERROR) << "Only grayscale image supported.";
+  if (num_octaves < 1) LOG(ERROR) << "Invalid num_octaves.";
+  if (num_scales < 1) LOG(ERROR) << "Invalid num_scales.";
+
+  const int kImagesPerOctave = num_scales + 3;
+  // Incremental sigmas, identical for all octaves.
+  const std::vector<double> incremental_sigmas =
+      IncrementalSigmas(num_scales, base_sigma);
+
+  std::vector<ScaleSpaceOctave> scale_space(num_octaves);
+  for (int o = 0; o < num_octaves; ++o) {
+    ScaleSpaceOctave& octave = scale_space[o];
+    if (o == 0) {
+      octave.rows = image.rows;
+      octave.cols = image.cols;
+    } else {
+      octave.rows = (scale_space[o - 1].rows + 1) / 2;
+      octave.cols = (scale_space[o - 1].cols + 1) / 2;
+    }
+    octave.num_images = kImagesPerOctave;
+    octave.data.create(kImagesPerOctave * octave.rows, octave.cols, CV_32F);
+
+    if (o == 0) {
+      cv::Mat base;
+      image.convertTo(base, CV_32F);
+      SeparableGaussianBlur(base, octave.image(0), incremental_sigmas[0]);
+    } else {
+      // Decimate the image with twice the first sigma of the previous octave.
+      DecimateByTwo(scale_space[o - 1].image(num_scales), octave.image(0));
+    }
+
+    for (int i = 1; i < kImagesPerOctave; ++i) {
+      SeparableGaussianBlur(octave.image(i - 1), octave.image(i),
+                            incremental_sigmas[i]);
+    }
+  }
+
+  return scale_space;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_SCALE_SPACE_H_
@@ -0,0 +1,47 @@
+#ifndef UZH_SIFT_SIFT_PARAMETERS_H_
+#define UZH_SIFT_SIFT_PARAMETERS_H_
+
+#include <sstream>
+#include <string>
+
+namespace uzh {
+
+//@brief Settings shared by the SIFT engines.
+struct SIFTParameters {
+  // Number of levels of the image pyramid.
+  int num_octaves = 5;
+  // Number of scales per octave.
+  int num_scales = 3;
+  // Sigma from which the sequence of sigmas of the Gaussians is generated.
+  double base_sigma = 1.0;
+  // Extrema of the DoGs whose absolute value is below it are suppressed.
+  double keypoints_threshold = 0.05;
+  // Whether to derotate the patches by the dominant orientations.
+  bool rotation_invariant = false;
+  // Whether to bin the gradients with trilinear interpolation.
+  bool trilinear = false;
+  // Whether to refine the extrema and reject the unstable, low contrast and
+  // edge-like ones before describing them, see RefineKeypoint.
+  bool refine_keypoints = true;
+  // Interpolated extrema whose absolute value is below it are rejected. Lowe's
+  // value for images in [0, 1].
+  double contrast_threshold = 0.03;
+  // Extrema whose ratio of principal curvatures exceeds it are rejected.
+  double edge_ratio = 10.0;
+};
+
+//@brief String encoding all settings, e.g. to key the features of an image in
+// a FeatureCache.
+inline std::string SIFTParametersKey(const SIFTParameters& params) {
+  std::ostringstream key;
+  key << "sift " << params.num_octaves << ' ' << params.num_scales << ' '
+      << params.base_sigma << ' ' << params.keypoints_threshold << ' '
+      << params.rotation_invariant << ' ' << params.trilinear << ' '
+      << params.refine_keypoints << ' ' << params.contrast_threshold << ' '
+      << params.edge_ratio;
+  return key.str();
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_SIFT_PARAMETERS_H_
@@ -0,0 +1,194 @@
+#ifndef UZH_SIFT_STREAMING_SIFT_H_
+#define UZH_SIFT_STREAMING_SIFT_H_
+
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "opencv2/core.hpp"
+#include "sift/derotate.h"
+#include "sift/find_extrema.h"
+#include "sift/gradient_cache.h"
+#include "sift/hog_descriptor.h"
+#include "sift/refine_keypoints.h"
+#include "sift/scale_space.h"
+#include "sift/sift_parameters.h"
+#include "transfer/view.h"
+
+namespace uzh {
+
+//@brief Run the fused blur -> DoG -> extremum -> descriptor pipeline on one
+// octave, keeping only three blurred and three DoG float32 slices alive.
+//! Blurred image i is computed from image i-1 with the incremental sigma and
+//! immediately subtracted from it. As soon as DoGs d-1, d and d+1 exist, the
+//! extrema of DoG d are found and described from blurred image d, whose
+//! gradient is only computed if there are extrema on it. Blurred image d is
+//! then overwritten by blurred image d+3, and likewise for the DoGs.
+//@param base Base image of the octave, single channel CV_32F.
+//@param is_blurred Whether base is already blurred with the first sigma of the
+// octave, which is the case for the decimated bases of the upper octaves.
+//@param params SIFT settings.
+//@param core Only the keypoints inside it are kept, e.g. the core of a tile.
+// Pass cv::Rect(0, 0, base.cols, base.rows) to keep all of them.
+//@param keypoints Output (row, col) coordinates of the keypoints in the octave,
+// appended pairwise.
+//@param descriptors Output normalized descriptors, appended 128 entries per
+// keypoint.
+//@param next_base If not nullptr, set to the base image of the next octave,
+// i.e. every second pixel of blurred image num_scales.
+//@param stats If not nullptr, the counts of the keypoint refinement of the
+// extrema inside core are accumulated into it.
+void StreamOctaveSIFT(const cv::Mat& base, const bool is_blurred,
+                      const uzh::SIFTParameters& params, const cv::Rect& core,
+                      std::vector<int>* keypoints,
+                      std::vector<float>* descriptors, cv::Mat* next_base,
+                      uzh::KeypointFilterStats* stats = nullptr) {
+  if (base.empty() || base.type() != CV_32F)
+    LOG(ERROR) << "base must be a non-empty CV_32F image.";
+  const int kImagesPerOctave = params.num_scales + 3;
+  const std::vector<double> incremental_sigmas =
+      uzh::IncrementalSigmas(params.num_scales, params.base_sigma);
+
+  // Ring buffers. Blurred image i and DoG i live in slot i % 3.
+  std::array<cv::Mat, 3> blurred, DoGs;
+  for (int k = 0; k < 3; ++k) {
+    blurred[k].create(base.size(), CV_32F);
+    DoGs[k].create(base.size(), CV_32F);
+  }
+  cv::Mat magnitude, direction;
+  std::vector<cv::Point2i> extrema;
+
+  for (int i = 0; i < kImagesPerOctave; ++i) {
+    cv::Mat& curr = blurred[i % 3];
+    if (i == 0) {
+      if (is_blurred) {
+        base.copyTo(curr);
+      } else {
+        uzh::SeparableGaussianBlur(base, curr, incremental_sigmas[0]);
+      }
+    } else {
+      uzh::SeparableGaussianBlur(blurred[(i - 1) % 3], curr,
+                                 incremental_sigmas[i]);
+      // DoG i-1.
+      cv::subtract(curr, blurred[(i - 1) % 3], DoGs[(i - 1) % 3]);
+    }
+
+    if (i == params.num_scales && next_base != nullptr) {
+      next_base->create((curr.rows + 1) / 2, (curr.cols + 1) / 2, CV_32F);
+      uzh::DecimateByTwo(curr, *next_base);
+    }
+
+    // DoGs i-3, i-2 and i-1 are available, find the extrema of DoG i-2.
+    if (i < 3) continue;
+    const int d = i - 2;
+    extrema.clear();
+    uzh::FindExtremaInSlice<float>(
+        DoGs[(d - 1) % 3], DoGs[d % 3], DoGs[(d + 1) % 3],
+        params.keypoints_threshold, uzh::MAXIMA_AND_MINIMA, &extrema);
+
+    //! Only DoGs d-1, d and d+1 are alive, hence the refinement cannot move
+    //! the sample point to another scale and rejects such extrema.
+    const auto D = [&DoGs](const int s, const int r, const int c) {
+      return static_cast<double>(DoGs[s % 3].at<float>(r, c));
+    };
+    bool has_gradient = false;
+    for (const cv::Point2i& e : extrema) {
+      int row = e.y, col = e.x;
+      if (!core.contains(e)) continue;
+      if (params.refine_keypoints) {
+        int slice = d;
+        const uzh::KeypointStability kStability = uzh::RefineKeypoint(
+            D, d, d, base.rows, base.cols, params.contrast_threshold,
+            params.edge_ratio, &slice, &row, &col);
+        if (stats != nullptr) stats->Add(kStability);
+        if (kStability != uzh::KEYPOINT_STABLE) continue;
+      }
+      if (!uzh::IsDescribable(row, col, base.rows, base.cols)) continue;
+      // Blurred image d is still in its slot.
+      if (!has_gradient) {
+        uzh::ComputeSliceGradient(blurred[d % 3], magnitude, direction);
+        has_gradient = true;
+      }
+      const uzh::StridedView<float> grad_magnitude =
+          uzh::strided_view<float>(magnitude);
+      const uzh::StridedView<float> grad_direction =
+          uzh::strided_view<float>(direction);
+      const double orientation =
+          params.rotation_invariant
+              ? uzh::ComputeDominantOrientation(grad_magnitude, grad_direction,
+                                                row, col)
+              : 0.0;
+
+      const size_t offset = descriptors->size();
+      descriptors->resize(offset + uzh::kSIFTDescriptorLength);
+      float* descriptor = descriptors->data() + offset;
+      uzh::ComputeHOGDescriptor(grad_magnitude, grad_direction, row, col,
+                                params.trilinear, descriptor, orientation);
+      // Normalize the descriptor to unit Euclidean norm.
+      double norm = 0.0;
+      for (int k = 0; k < uzh::kSIFTDescriptorLength; ++k)
+        norm += descriptor[k] * descriptor[k];
+      norm = std::sqrt(norm);
+      if (norm > 0) {
+        for (int k = 0; k < uzh::kSIFTDescriptorLength; ++k)
+          descriptor[k] /= norm;
+      }
+      keypoints->push_back(row);
+      keypoints->push_back(col);
+    }
+  }
+}
+
+//@brief Streaming counterpart of the SIFT pipeline, i.e. ComputeImagePyramid,
+// ComputeBlurredImages, ComputeDoGs, ExtractKeypoints and ComputeDescriptors.
+//! Rather than materializing cubes of blurred images and DoGs of all octaves in
+//! double, each octave is processed by StreamOctaveSIFT, hence the peak memory
+//! is about eight float32 images of the first octave. This makes full
+//! resolution images affordable.
+//! The scale space is built incrementally as in ComputeScaleSpace, and the
+//! extrema are both the maxima and the minima of the signed DoGs.
+//@param image Single channel image to be processed, e.g. from GetImageSIFT.
+//@param params SIFT settings.
+//@param stats If not nullptr, the counts of the keypoint refinement are
+// accumulated into it.
+//@return descriptors -- [128 x n] matrix where each column is a normalized
+// descriptor; keypoints -- [2 x n] matrix where each column contains the (row,
+// col) coordinates of the keypoint in the original image.
+std::tuple<arma::mat /*descriptors*/, arma::umat /*keypoints*/> StreamingSIFT(
+    const cv::Mat& image, const uzh::SIFTParameters& params,
+    uzh::KeypointFilterStats* stats = nullptr) {
+  if (image.empty()) LOG(ERROR) << "Empty input image.";
+  if (image.channels() != 1) LOG(ERROR) << "Only grayscale image supported.";
+
+  std::vector<int> octave_keypoints;
+  std::vector<float> descriptors;
+  std::vector<arma::uword> keypoints;
+
+  cv::Mat base, next_base;
+  image.convertTo(base, CV_32F);
+  for (int o = 0; o < params.num_octaves; ++o) {
+    octave_keypoints.clear();
+    uzh::StreamOctaveSIFT(base, o > 0, params,
+                          cv::Rect(0, 0, base.cols, base.rows),
+                          &octave_keypoints, &descriptors,
+                          o + 1 < params.num_octaves ? &next_base : nullptr,
+                          stats);
+    // Map the coordinates back to the original image resolution.
+    for (const int v : octave_keypoints) keypoints.push_back(v << o);
+    cv::swap(base, next_base);
+  }
+
+  const arma::uword kNumKeypoints = keypoints.size() / 2;
+  if (kNumKeypoints == 0)
+    return {arma::mat(uzh::kSIFTDescriptorLength, 0), arma::umat(2, 0)};
+  return {arma::conv_to<arma::mat>::from(arma::fmat(
+              descriptors.data(), uzh::kSIFTDescriptorLength, kNumKeypoints)),
+          arma::umat(keypoints.data(), 2, kNumKeypoints)};
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_STREAMING_SIFT_H_
@@ -0,0 +1,147 @@
+#ifndef UZH_SIFT_TILED_SIFT_H_
+#define UZH_SIFT_TILED_SIFT_H_
+
+#include <algorithm>  // std::min
+#include <tuple>
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "opencv2/core.hpp"
+#include "parallel/thread_pool.h"
+#include "sift/hog_descriptor.h"
+#include "sift/refine_keypoints.h"
+#include "sift/scale_space.h"
+#include "sift/sift_parameters.h"
+#include "sift/streaming_sift.h"
+
+namespace uzh {
+
+//@brief Width of the halo around the core of a tile such that the blurred
+// images, the DoGs and the descriptors computed in the core of the tile are
+// the same as the ones computed on the whole octave.
+//! The error caused by the border of the tile grows inwards by the kernel
+//! radius with each incremental blur. On top of that, the extremum detection
+//! reads 1 pixel around a keypoint, the refinement may move a keypoint of the
+//! core by up to kSIFTMaxRefinementSteps pixels out of it, and the derotated
+//! descriptor reads up to 12 pixels plus 1 pixel of Sobel support. The halo is
+//! made even such that the tiles are aligned with the decimation grid of the
+//! next octave.
+inline int SIFTTileHalo(const uzh::SIFTParameters& params) {
+  const int kDescriptorMargin = 12 + 1;
+  int halo = kDescriptorMargin;
+  if (params.refine_keypoints) halo += uzh::kSIFTMaxRefinementSteps;
+  for (const double sigma :
+       uzh::IncrementalSigmas(params.num_scales, params.base_sigma))
+    halo += uzh::GaussianKernelRadius(sigma);
+  return halo + halo % 2;
+}
+
+//@brief Tiled counterpart of StreamingSIFT, processing the tiles of each
+// octave in parallel.
+//! Each octave is partitioned into cores of tile_size x tile_size pixels. A
+//! tile is a core grown by SIFTTileHalo on each side, clipped to the octave,
+//! and is processed by StreamOctaveSIFT as a standalone image. Only the
+//! keypoints in the core are kept, hence the keypoints found in the halos are
+//! not duplicated, and the decimated core is written to the base image of the
+//! next octave. The memory of a tile is bounded by about eight float32 images
+//! of (tile_size + 2 * halo)^2 pixels, irrespective of the image size.
+//! The keypoints and descriptors are the same as the ones of StreamingSIFT up
+//! to floating point rounding, though ordered tile by tile.
+//@param image Single channel image to be processed, e.g. from GetImageSIFT.
+//@param params SIFT settings.
+//@param tile_size Size of the cores, which must be positive and even.
+//@param pool Thread pool on which the tiles are processed.
+//@param stats If not nullptr, the counts of the keypoint refinement are
+// accumulated into it.
+//@return descriptors -- [128 x n] matrix where each column is a normalized
+// descriptor; keypoints -- [2 x n] matrix where each column contains the (row,
+// col) coordinates of the keypoint in the original image.
+std::tuple<arma::mat /*descriptors*/, arma::umat /*keypoints*/> TiledSIFT(
+    const cv::Mat& image, const uzh::SIFTParameters& params,
+    const int tile_size = 512,
+    uzh::ThreadPool& pool = uzh::ThreadPool::Global(),
+    uzh::KeypointFilterStats* stats = nullptr) {
+  if (image.empty()) LOG(ERROR) << "Empty input image.";
+  if (image.channels() != 1) LOG(ERROR) << "Only grayscale image supported.";
+  if (tile_size <= 0 || tile_size % 2 != 0)
+    LOG(ERROR) << "tile_size must be positive and even.";
+
+  const int kHalo = SIFTTileHalo(params);
+
+  struct TileFeatures {
+    std::vector<int> keypoints;
+    std::vector<float> descriptors;
+    uzh::KeypointFilterStats stats;
+  };
+  std::vector<float> descriptors;
+  std::vector<arma::uword> keypoints;
+
+  cv::Mat base, next_base;
+  image.convertTo(base, CV_32F);
+  for (int o = 0; o < params.num_octaves; ++o) {
+    const cv::Rect kOctaveRect(0, 0, base.cols, base.rows);
+    const int kNumTileRows = (base.rows + tile_size - 1) / tile_size;
+    const int kNumTileCols = (base.cols + tile_size - 1) / tile_size;
+    const bool kHasNextOctave = o + 1 < params.num_octaves;
+    if (kHasNextOctave)
+      next_base.create((base.rows + 1) / 2, (base.cols + 1) / 2, CV_32F);
+
+    std::vector<TileFeatures> tile_features(kNumTileRows * kNumTileCols);
+    pool.ParallelFor(
+        0, kNumTileRows * kNumTileCols,
+        [&](const int t) {
+          const int x = (t % kNumTileCols) * tile_size;
+          const int y = (t / kNumTileCols) * tile_size;
+          const cv::Rect core(x, y, std::min(tile_size, base.cols - x),
+                              std::min(tile_size, base.rows - y));
+          const cv::Rect tile =
+              cv::Rect(x - kHalo, y - kHalo, core.width + 2 * kHalo,
+                       core.height + 2 * kHalo) &
+              kOctaveRect;
+
+          // The ROI is blurred as a standalone image, hence no copy is needed.
+          TileFeatures& features = tile_features[t];
+          cv::Mat tile_next_base;
+          uzh::StreamOctaveSIFT(base(tile), o > 0, params, core - tile.tl(),
+                                &features.keypoints, &features.descriptors,
+                                kHasNextOctave ? &tile_next_base : nullptr,
+                                &features.stats);
+          for (size_t k = 0; k < features.keypoints.size(); k += 2) {
+            features.keypoints[k] += tile.y;
+            features.keypoints[k + 1] += tile.x;
+          }
+
+          if (kHasNextOctave) {
+            // Both the tile and the core start at even coordinates, hence
+            // the decimated tile is aligned with the next octave.
+            const cv::Rect next_core(core.x / 2, core.y / 2,
+                                     (core.width + 1) / 2,
+                                     (core.height + 1) / 2);
+            tile_next_base(next_core - tile.tl() / 2)
+                .copyTo(next_base(next_core));
+          }
+        },
+        1);
+
+    for (const TileFeatures& features : tile_features) {
+      // Map the coordinates back to the original image resolution.
+      for (const int v : features.keypoints) keypoints.push_back(v << o);
+      descriptors.insert(descriptors.end(), features.descriptors.begin(),
+                         features.descriptors.end());
+      if (stats != nullptr) *stats += features.stats;
+    }
+    cv::swap(base, next_base);
+  }
+
+  const arma::uword kNumKeypoints = keypoints.size() / 2;
+  if (kNumKeypoints == 0)
+    return {arma::mat(uzh::kSIFTDescriptorLength, 0), arma::umat(2, 0)};
+  return {arma::conv_to<arma::mat>::from(arma::fmat(
+              descriptors.data(), uzh::kSIFTDescriptorLength, kNumKeypoints)),
+          arma::umat(keypoints.data(), 2, kNumKeypoints)};
+}
+
+}  // namespace uzh
+
+#endif  // UZH_SIFT_TILED_SIFT_H_
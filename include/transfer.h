@@ -9,5 +9,6 @@
 #include "transfer/eigen2arma.h"
 #include "transfer/eigen2cv.h"
 #include "transfer/img2arma.h"
+#include "transfer/view.h"
 
 #endif  // UZH_TRANSFER_H_
\ No newline at end of file
@@ -3,18 +3,14 @@
 
 #include "Eigen/Core"
 #include "armadillo"
-#include "transfer/arma2cv.h"
-#include "transfer/cv2eigen.h"
+#include "transfer/view.h"
 
 namespace uzh {
 
-// Eigen::MatrixXd arma2eigen(arma::mat &A) {
-//   return Eigen::Map<Eigen::MatrixXd>(A.memptr(), A.n_rows, A.n_cols);
-// }
-
+//! Both armadillo and Eigen are column-major, hence a single copy through
+//! a view suffices. Use uzh::arma2eigen_view to avoid the copy as well.
 Eigen::MatrixXd arma2eigen(const arma::mat &A) {
-  cv::Mat cv_mat = uzh::arma2cv<double>(A);
-  return uzh::cv2eigen<double>(cv_mat);
+  return uzh::arma2eigen_view(A);
 }
 
 }  // namespace uzh
@@ -3,21 +3,14 @@
 
 #include "Eigen/Core"
 #include "armadillo"
-#include "opencv2/core/eigen.hpp"
-#include "transfer/cv2arma.h"
-#include "transfer/eigen2cv.h"
 
 namespace uzh {
 
-// arma::mat eigen2arma(Eigen::MatrixXd &E, bool copy = true) {
-//   return arma::mat(E.data(), E.rows(), E.cols(), /*copy_aux_mem*/ copy,
-//                    /*strict*/ false);
-// }
-
-arma::mat eigen2arma(const Eigen::MatrixXd &E, bool copy = true) {
-  cv::Mat cv_mat;
-  cv::eigen2cv(E, cv_mat);
-  return uzh::cv2arma<double>(cv_mat).t();
+//! Both armadillo and Eigen are column-major, hence the data is copied once
+//! as is. Use uzh::eigen2arma_view to avoid the copy as well.
+arma::mat eigen2arma(const Eigen::MatrixXd &E) {
+  return arma::mat(E.data(), static_cast<arma::uword>(E.rows()),
+                   static_cast<arma::uword>(E.cols()));
 }
 
 }  // namespace uzh
@@ -0,0 +1,140 @@
+#ifndef UZH_TRANSFER_VIEW_H_
+#define UZH_TRANSFER_VIEW_H_
+
+#include <cstddef>  // std::ptrdiff_t
+
+#include "Eigen/Core"
+#include "armadillo"
+#include "glog/logging.h"
+#include "opencv2/core.hpp"
+#include "transfer/cv2eigen.h"
+
+namespace uzh {
+
+//! Zero-copy views between arma::Mat, Eigen::Matrix and cv::Mat.
+//!
+//! None of the functions below allocate or copy: the returned object is a
+//! header over the storage of the input, which must therefore outlive it.
+//! The memory layout is handled explicitly rather than by transposing data:
+//! - arma::Mat and the default Eigen::Matrix are column-major;
+//! - cv::Mat and MatrixXrm are row-major.
+//! Viewing a column-major [m x n] matrix as row-major, or vice versa, yields
+//! its [n x m] transpose. The names of the functions ending with _t remind of
+//! this.
+
+// Eigen map over a possibly strided row-major buffer, e.g. a cv::Mat ROI.
+template <typename V>
+using MatrixXrmMap =
+    Eigen::Map<MatrixXrm<V>, Eigen::Unaligned, Eigen::OuterStride<>>;
+template <typename V>
+using ConstMatrixXrmMap =
+    Eigen::Map<const MatrixXrm<V>, Eigen::Unaligned, Eigen::OuterStride<>>;
+
+//@brief View an arma::Mat as an Eigen matrix of the same size.
+template <typename V>
+Eigen::Map<MatrixX<V>> arma2eigen_view(arma::Mat<V>& A) {
+  return Eigen::Map<MatrixX<V>>(A.memptr(), A.n_rows, A.n_cols);
+}
+template <typename V>
+Eigen::Map<const MatrixX<V>> arma2eigen_view(const arma::Mat<V>& A) {
+  return Eigen::Map<const MatrixX<V>>(A.memptr(), A.n_rows, A.n_cols);
+}
+
+//@brief View a column-major Eigen matrix as an arma::Mat of the same size.
+//! Armadillo's advanced constructor with copy_aux_mem = false is used and
+//! strict = true forbids the returned matrix from being resized, which would
+//! silently detach it from the Eigen storage.
+template <typename Derived>
+arma::Mat<typename Derived::Scalar> eigen2arma_view(
+    Eigen::PlainObjectBase<Derived>& E) {
+  static_assert(!Derived::IsRowMajor, "eigen2arma_view needs column-major.");
+  return arma::Mat<typename Derived::Scalar>(
+      E.data(), static_cast<arma::uword>(E.rows()),
+      static_cast<arma::uword>(E.cols()), /*copy_aux_mem*/ false,
+      /*strict*/ true);
+}
+
+//@brief View a cv::Mat as a row-major Eigen matrix of the same size.
+//! The row stride of the cv::Mat is honored, hence ROIs are supported.
+template <typename V>
+MatrixXrmMap<V> cv2eigen_view(cv::Mat& C) {
+  if (C.channels() != 1) LOG(ERROR) << "Only single channel cv::Mat supported.";
+  return MatrixXrmMap<V>(C.ptr<V>(), C.rows, C.cols,
+                         Eigen::OuterStride<>(C.step1()));
+}
+template <typename V>
+ConstMatrixXrmMap<V> cv2eigen_view(const cv::Mat& C) {
+  if (C.channels() != 1) LOG(ERROR) << "Only single channel cv::Mat supported.";
+  return ConstMatrixXrmMap<V>(C.ptr<V>(), C.rows, C.cols,
+                              Eigen::OuterStride<>(C.step1()));
+}
+
+//@brief View a row-major Eigen matrix as a cv::Mat of the same size.
+template <typename V>
+cv::Mat_<V> eigen2cv_view(MatrixXrm<V>& E) {
+  return cv::Mat_<V>(static_cast<int>(E.rows()), static_cast<int>(E.cols()),
+                     E.data());
+}
+
+//@brief View a column-major Eigen matrix as a cv::Mat holding its transpose.
+template <typename V>
+cv::Mat_<V> eigen2cv_view_t(MatrixX<V>& E) {
+  return cv::Mat_<V>(static_cast<int>(E.cols()), static_cast<int>(E.rows()),
+                     E.data());
+}
+
+//@brief View an arma::Mat as a cv::Mat holding its transpose.
+//! Column j of A is row j of the returned cv::Mat. This is the copy-free
+//! counterpart of cv::Mat(uzh::arma2cv(A)).t().
+template <typename V>
+cv::Mat_<V> arma2cv_view_t(arma::Mat<V>& A) {
+  return cv::Mat_<V>(static_cast<int>(A.n_cols), static_cast<int>(A.n_rows),
+                     A.memptr());
+}
+
+//@brief View a continuous cv::Mat as an arma::Mat holding its transpose.
+//! Row i of C is column i of the returned arma::Mat. This is
+//! uzh::cv2arma(C, false) with the strict flag set.
+template <typename V>
+arma::Mat<V> cv2arma_view_t(cv::Mat& C) {
+  if (!C.isContinuous()) LOG(ERROR) << "cv::Mat must be continuous.";
+  return arma::Mat<V>(C.ptr<V>(), static_cast<arma::uword>(C.cols),
+                      static_cast<arma::uword>(C.rows),
+                      /*copy_aux_mem*/ false, /*strict*/ true);
+}
+
+//@brief Read-only 2D view over a strided buffer.
+//! Element (r, c) is data[r * row_stride + c * col_stride], hence kernels
+//! written against StridedView run unchanged on column-major arma::Mat and
+//! row-major cv::Mat, without converting or transposing either of them.
+template <typename T>
+struct StridedView {
+  const T* data;
+  int rows;
+  int cols;
+  std::ptrdiff_t row_stride;
+  std::ptrdiff_t col_stride;
+
+  const T& operator()(const int r, const int c) const {
+    return data[r * row_stride + c * col_stride];
+  }
+};
+
+//@brief View an arma::Mat as a StridedView.
+template <typename V>
+StridedView<V> strided_view(const arma::Mat<V>& A) {
+  return {A.memptr(), static_cast<int>(A.n_rows), static_cast<int>(A.n_cols),
+          1, static_cast<std::ptrdiff_t>(A.n_rows)};
+}
+
+//@brief View a single channel cv::Mat, possibly an ROI, as a StridedView.
+template <typename V>
+StridedView<V> strided_view(const cv::Mat& C) {
+  if (C.channels() != 1) LOG(ERROR) << "Only single channel cv::Mat supported.";
+  return {C.ptr<V>(), C.rows, C.cols, static_cast<std::ptrdiff_t>(C.step1()),
+          1};
+}
+
+}  // namespace uzh
+
+#endif  // UZH_TRANSFER_VIEW_H_
@@ -1,14 +1,21 @@
 #ifndef UZH_TWO_VIEW_GEOMETRY_H_
 #define UZH_TWO_VIEW_GEOMETRY_H_
 
+#include "two_view_geometry/batch_triangulation.h"
 #include "two_view_geometry/decompose_essential_matrix.h"
 #include "two_view_geometry/disambiguate_relative_poses.h"
+#include "two_view_geometry/epipolar_normal_equations.h"
+#include "two_view_geometry/epipolar_residuals.h"
+#include "two_view_geometry/essential_5point.h"
 #include "two_view_geometry/estimate_essential_matrix.h"
 #include "two_view_geometry/fundamental_8point.h"
 #include "two_view_geometry/fundamental_normalized_8point.h"
 #include "two_view_geometry/nonlinear_triangulation.h"
 #include "two_view_geometry/normalize_points.h"
 #include "two_view_geometry/points_to_epipolar_line_distance.h"
+#include "two_view_geometry/ransac_essential_matrix.h"
+#include "two_view_geometry/refine_triangulation.h"
+#include "two_view_geometry/sampson_distance.h"
 #include "two_view_geometry/triangulation.h"
 
 #endif  // UZH_TWO_VIEW_GEOMETRY_H_
\ No newline at end of file
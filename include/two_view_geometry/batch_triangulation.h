@@ -0,0 +1,97 @@
+#ifndef UZH_TWO_VIEW_GEOMETRY_BATCH_TRIANGULATION_H_
+#define UZH_TWO_VIEW_GEOMETRY_BATCH_TRIANGULATION_H_
+
+#include "Eigen/Core"
+#include "Eigen/Eigenvalues"
+#include "armadillo"
+#include "glog/logging.h"
+#include "parallel/thread_pool.h"
+#include "two_view_geometry/sampson_distance.h"
+
+namespace uzh {
+
+// Number of consecutive points triangulated by one task of the thread pool.
+constexpr int kTriangulationGrainSize = 256;
+
+//@brief Triangulate one point from its dehomogenized image points (x1, y1)
+// and (x2, y2), see LinearTriangulation.
+//! Instead of the SVD of the [6 x 4] matrix A stacking hat(p1) * M1 and
+//! hat(p2) * M2, the eigenvector of the smallest eigenvalue of the [4 x 4]
+//! normal matrix A' * A is computed, which is the same vector. A' * A is
+//! accumulated from the rows of A without forming A, and the eigenvector is
+//! found by a fixed-size solver, hence nothing is allocated.
+//@param M1 [3 x 4] projection matrix of the left camera in column-major order.
+//@param M2 [3 x 4] projection matrix of the right camera in column-major order.
+//@param P Output homogeneous coordinates of the 3D scene point, with P[3] = 1.
+inline void TriangulatePoint(const double* M1, const double* M2,
+                             const double x1, const double y1,
+                             const double x2, const double y2, double* P) {
+  Eigen::Matrix4d N = Eigen::Matrix4d::Zero();
+  const auto accumulate = [&N](const double* M, const double x,
+                               const double y) {
+    const Eigen::Map<const Eigen::Matrix<double, 3, 4>> kM(M);
+    // Rows of hat(p) * M with p = (x, y, 1).
+    const Eigen::RowVector4d kRows[3] = {y * kM.row(2) - kM.row(1),
+                                         kM.row(0) - x * kM.row(2),
+                                         x * kM.row(1) - y * kM.row(0)};
+    for (const Eigen::RowVector4d& row : kRows)
+      N.selfadjointView<Eigen::Lower>().rankUpdate(row.transpose());
+  };
+  accumulate(M1, x1, y1);
+  accumulate(M2, x2, y2);
+
+  //! The eigenvalues are sorted in increasing order.
+  const Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> kEigenSolver(N);
+  const Eigen::Vector4d kP = kEigenSolver.eigenvectors().col(0);
+  // Dehomogenize.
+  P[0] = kP(0) / kP(3);
+  P[1] = kP(1) / kP(3);
+  P[2] = kP(2) / kP(3);
+  P[3] = 1.0;
+}
+
+//@brief Linear triangulation of all correspondences in parallel, numerically
+// equivalent to LinearTriangulation.
+//@param correspondences Correspondences from PackEpipolarCorrespondences, i.e.
+// the dehomogenized image points stored as structure of arrays.
+//@param M1 [3 x 4] projection matrix K1[I|0] for the left camera.
+//@param M2 [3 x 4] projection matrix K2[R|t] for the right camera.
+//@param pool Thread pool across whose workers the points are split.
+//@return P -- [4 x n] matrix where each column contains the homogeneous
+// coordinates for a 3D scene point P in the left camera frame.
+arma::mat /* P */
+BatchLinearTriangulation(const uzh::EpipolarCorrespondences& correspondences,
+                         const arma::mat& M1, const arma::mat& M2,
+                         uzh::ThreadPool& pool = uzh::ThreadPool::Global()) {
+  if (M1.n_rows != 3 || M1.n_cols != 4 || M2.n_rows != 3 || M2.n_cols != 4)
+    LOG(ERROR) << "Invalid projection matrix.";
+
+  const int kNumPoints = correspondences.size();
+  arma::mat P(4, kNumPoints);
+  const double* x1 = correspondences.x1.data();
+  const double* y1 = correspondences.y1.data();
+  const double* x2 = correspondences.x2.data();
+  const double* y2 = correspondences.y2.data();
+  pool.ParallelFor(
+      0, kNumPoints,
+      [&](const int i) {
+        uzh::TriangulatePoint(M1.memptr(), M2.memptr(), x1[i], y1[i], x2[i],
+                              y2[i], P.colptr(i));
+      },
+      kTriangulationGrainSize);
+  return P;
+}
+
+//@brief Overload taking the homogeneous image points, see
+// LinearTriangulation for the parameters.
+arma::mat /* P */
+BatchLinearTriangulation(const arma::mat& p1, const arma::mat& p2,
+                         const arma::mat& M1, const arma::mat& M2,
+                         uzh::ThreadPool& pool = uzh::ThreadPool::Global()) {
+  return uzh::BatchLinearTriangulation(uzh::PackEpipolarCorrespondences(p1, p2),
+                                       M1, M2, pool);
+}
+
+}  // namespace uzh
+
+#endif  // UZH_TWO_VIEW_GEOMETRY_BATCH_TRIANGULATION_H_
@@ -1,14 +1,65 @@
 #ifndef UZH_TWO_VIEW_GEOMETRY_DISAMBIGUATE_RELATIVE_POSES_H_
 #define UZH_TWO_VIEW_GEOMETRY_DISAMBIGUATE_RELATIVE_POSES_H_
 
+#include <algorithm>  // std::min, std::max
+#include <atomic>
+#include <numeric>  // std::iota
+#include <random>
 #include <tuple>
+#include <utility>  // std::swap
+#include <vector>
 
 #include "armadillo"
 #include "glog/logging.h"
-#include "two_view_geometry/triangulation.h"
+#include "parallel/thread_pool.h"
+#include "two_view_geometry/batch_triangulation.h"
+#include "two_view_geometry/sampson_distance.h"
 
 namespace uzh {
 
+//@brief Count the correspondences whose triangulated 3D scene points are in
+// front of the left camera, and those in front of the right camera.
+//! The points are triangulated with TriangulatePoint as in
+//! BatchLinearTriangulation, but only their depths are kept, hence nothing is
+//! allocated per point.
+//@param correspondences Correspondences from PackEpipolarCorrespondences.
+//@param M1 [3 x 4] projection matrix K1[I|0] for the left camera.
+//@param M2 [3 x 4] projection matrix K2[R|t] for the right camera.
+//@param R Rotation from the left to the right camera frame.
+//@param t Translation from the left to the right camera frame.
+//@param pool Thread pool across whose workers the points are split.
+//@return Total number of positive depths in both cameras.
+int CountPositiveDepths(const uzh::EpipolarCorrespondences& correspondences,
+                        const arma::mat& M1, const arma::mat& M2,
+                        const arma::mat& R, const arma::vec& t,
+                        uzh::ThreadPool& pool = uzh::ThreadPool::Global()) {
+  const int kNumPoints = correspondences.size();
+  const int kNumChunks =
+      (kNumPoints + kTriangulationGrainSize - 1) / kTriangulationGrainSize;
+  std::atomic<int> num_positive_depths{0};
+  pool.ParallelFor(
+      0, kNumChunks,
+      [&](const int chunk) {
+        const int kFirst = chunk * kTriangulationGrainSize;
+        const int kLast =
+            std::min(kNumPoints, kFirst + kTriangulationGrainSize);
+        int num_chunk_positive_depths = 0;
+        double P[4];
+        for (int i = kFirst; i < kLast; ++i) {
+          uzh::TriangulatePoint(M1.memptr(), M2.memptr(),
+                                correspondences.x1[i], correspondences.y1[i],
+                                correspondences.x2[i], correspondences.y2[i],
+                                P);
+          const double kDepth2 =
+              R(2, 0) * P[0] + R(2, 1) * P[1] + R(2, 2) * P[2] + t(2);
+          num_chunk_positive_depths += (P[2] > 0) + (kDepth2 > 0);
+        }
+        num_positive_depths += num_chunk_positive_depths;
+      },
+      1);
+  return num_positive_depths;
+}
+
 //@brief Disambiguate the four possible combinations of R, t by applying a
 // positive-depth test.
 //@param Rs The two possible rotations.
@@ -20,6 +71,9 @@ namespace uzh {
 // coordinates of image points p2 on the right camera.
 //@param K1 [3 x 3] calibration matrix for the left camera.
 //@param K2 [3 x 3] calibration matrix for the right camera.
+//@param num_samples If positive and smaller than n, the combinations are first
+// voted on by a random subset of num_samples correspondences, and all of them
+// are only used if the vote of the subset is not decisive.
 //@return R -- The final rotation matrix; t -- The final translation vector. The
 // rigid transformation formed by R and t transforms 3D scene points from world
 // coordinate to the right camera coordinate. And we further assume the world
@@ -30,10 +84,17 @@ namespace uzh {
 //! of points with positive depth.
 //! The calibration matrices in conjunction with the relative poses R and t are
 //! used to construct the projection marices to be passed in the
-//! LinearTriangulation function.
+//! TriangulatePoint function, see CountPositiveDepths.
+//! The correct combination has (almost) all points in front of both cameras,
+//! whereas each of the others has at most half of the depths positive, hence a
+//! few dozen correspondences suffice unless most of them are outliers or the
+//! baseline is degenerate. The vote of the subset is decisive if the winner
+//! has at least kDecisiveRatio of the depths positive and twice as many as the
+//! runner-up.
 std::tuple<arma::mat /* R */, arma::vec /* t */> DisambiguateRelativePoses(
     const arma::field<arma::mat>& Rs, const arma::vec& u, const arma::mat& p1,
-    const arma::mat& p2, const arma::mat& K1, const arma::mat& K2) {
+    const arma::mat& p2, const arma::mat& K1, const arma::mat& K2,
+    const int num_samples = 0) {
   if (p1.n_cols != p2.n_cols)
     LOG(ERROR) << "Number of points of p1 and p2 must be consistent.";
   if (p1.n_rows != 3 || p2.n_rows != 3)
@@ -46,40 +107,73 @@ std::tuple<arma::mat /* R */, arma::vec /* t */> DisambiguateRelativePoses(
   ts(0) = u;
   ts(1) = -u;
 
-  // Voting by counting the number of triangulated points with positive depth.
-  arma::mat R_final;
-  arma::vec t_final;
-  int max_num_points_pdepth = 0;
   // M1 = K1 * [I|0] as we assumed.
   const arma::mat M1 = K1 * arma::eye<arma::mat>(3, 4);
-  for (arma::mat R : Rs) {
-    for (arma::vec t : ts) {
-      // Construct projection matrix M2 from R and t.
-      const arma::mat M2 = K2 * arma::join_horiz(R, t);
-
-      // Triangulate 3D scene points.
-      //! The triangulated 3D scene points are in the left camera frame as we've
-      //! assumed the left camera frame is identical to the world frame.
-      const arma::mat P_C_1 = LinearTriangulation(p1, p2, M1, M2);
-      // Transform to the right camera frame.
-      const arma::mat P_C_2 = arma::join_horiz(R, t) * P_C_1;
+  // Construct projection matrices M2 from R and t.
+  arma::field<arma::mat> M2s(Rs.n_elem, ts.n_elem);
+  for (arma::uword r = 0; r < Rs.n_elem; ++r) {
+    for (arma::uword k = 0; k < ts.n_elem; ++k)
+      M2s(r, k) = K2 * arma::join_horiz(Rs(r), ts(k));
+  }
 
-      // Counting the number points in front of both cameras.
-      const int num_points_pdepth_1 = arma::sum(P_C_1.row(2) > 0);
-      const int num_points_pdepth_2 = arma::sum(P_C_2.row(2) > 0);
-      const int num_points_pdepth_total =
-          num_points_pdepth_1 + num_points_pdepth_2;
-      // Keep the combination of R, t with highest number of points in front of
-      // both cameras.
-      if (num_points_pdepth_total > max_num_points_pdepth) {
-        max_num_points_pdepth = num_points_pdepth_total;
-        R_final = R;
-        t_final = t;
+  // Voting by counting the number of triangulated points with positive depth.
+  //! The triangulated 3D scene points are in the left camera frame as we've
+  //! assumed the left camera frame is identical to the world frame.
+  // Returns the index r * 2 + k of the winner Rs(r), ts(k) and whether the
+  // vote is decisive.
+  const auto vote = [&](const uzh::EpipolarCorrespondences& correspondences) {
+    int max_num_points_pdepth = 0, second_num_points_pdepth = 0;
+    int winner = 0;
+    for (arma::uword r = 0; r < Rs.n_elem; ++r) {
+      for (arma::uword k = 0; k < ts.n_elem; ++k) {
+        const int num_points_pdepth_total = uzh::CountPositiveDepths(
+            correspondences, M1, M2s(r, k), Rs(r), ts(k));
+        // Keep the combination of R, t with highest number of points in front
+        // of both cameras.
+        if (num_points_pdepth_total > max_num_points_pdepth) {
+          second_num_points_pdepth = max_num_points_pdepth;
+          max_num_points_pdepth = num_points_pdepth_total;
+          winner = r * ts.n_elem + k;
+        } else {
+          second_num_points_pdepth =
+              std::max(second_num_points_pdepth, num_points_pdepth_total);
+        }
       }
     }
+    const double kDecisiveRatio = 0.75;
+    const bool kIsDecisive =
+        max_num_points_pdepth >= kDecisiveRatio * 2 * correspondences.size() &&
+        max_num_points_pdepth >= 2 * second_num_points_pdepth;
+    return std::make_tuple(winner, kIsDecisive);
+  };
+
+  const uzh::EpipolarCorrespondences correspondences =
+      uzh::PackEpipolarCorrespondences(p1, p2);
+  const int kNumPoints = correspondences.size();
+  int winner = 0;
+  bool is_decisive = false;
+  if (num_samples > 0 && num_samples < kNumPoints) {
+    // Vote on a random subset first. The generator is seeded deterministically
+    // such that the poses are reproducible.
+    std::mt19937 generator(0);
+    std::vector<int> indices(kNumPoints);
+    std::iota(indices.begin(), indices.end(), 0);
+    uzh::EpipolarCorrespondences samples;
+    for (int k = 0; k < num_samples; ++k) {
+      // Partial Fisher-Yates shuffle.
+      std::uniform_int_distribution<int> distribution(k, kNumPoints - 1);
+      std::swap(indices[k], indices[distribution(generator)]);
+      samples.x1.push_back(correspondences.x1[indices[k]]);
+      samples.y1.push_back(correspondences.y1[indices[k]]);
+      samples.x2.push_back(correspondences.x2[indices[k]]);
+      samples.y2.push_back(correspondences.y2[indices[k]]);
+    }
+    std::tie(winner, is_decisive) = vote(samples);
   }
+  // Fall back to all correspondences if ambiguous.
+  if (!is_decisive) std::tie(winner, std::ignore) = vote(correspondences);
 
-  return {R_final, t_final};
+  return {Rs(winner / ts.n_elem), ts(winner % ts.n_elem)};
 }
 
 }  // namespace uzh
@@ -0,0 +1,171 @@
+#ifndef UZH_TWO_VIEW_GEOMETRY_EPIPOLAR_NORMAL_EQUATIONS_H_
+#define UZH_TWO_VIEW_GEOMETRY_EPIPOLAR_NORMAL_EQUATIONS_H_
+
+#include <algorithm>  // std::min
+#include <tuple>
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "parallel/thread_pool.h"
+#include "two_view_geometry/normalize_points.h"
+
+namespace uzh {
+
+// Number of consecutive correspondences accumulated by one task of the thread
+// pool.
+constexpr int kNormalEquationsGrainSize = 4096;
+
+//@brief Normal equations Q' * Q of the 8-point algorithm, see
+// Fundamental8Point, accumulated from streamed correspondences such that the
+// [n x 9] matrix Q is never formed.
+//! The memory is constant in the number of correspondences, and solving for F
+//! takes the eigendecomposition of a [9 x 9] symmetric matrix instead of the
+//! SVD of Q. The correspondences may be added in chunks of any size, and
+//! accumulators filled by different threads are summed with +=.
+//! The points are normalized by the transformations T1 and T2 given upfront,
+//! which, unlike with NormalizePoints, cannot depend on all points if they are
+//! streamed. Any similarity mapping the points to coordinates of order 1
+//! does, e.g. the one computed by NormalizePoints from the first chunk or the
+//! one centering and scaling the image.
+class EpipolarNormalEquations {
+ public:
+  //@param T1 [3 x 3] normalization of the points on the left camera.
+  //@param T2 [3 x 3] normalization of the points on the right camera.
+  explicit EpipolarNormalEquations(
+      const arma::mat& T1 = arma::eye<arma::mat>(3, 3),
+      const arma::mat& T2 = arma::eye<arma::mat>(3, 3))
+      : T1_(T1), T2_(T2) {
+    QtQ_.zeros();
+  }
+
+  //@brief Accumulate a chunk of correspondences.
+  //@param p1 [3 x m] matrix where each column contains the homogeneous
+  // coordinates of image points p1 on the left camera.
+  //@param p2 [3 x m] matrix where each column contains the homogeneous
+  // coordinates of image points p2 on the right camera.
+  //@param first Index of the first column to be accumulated.
+  //@param last One past the index of the last column to be accumulated. If
+  // negative, the columns up to the end are accumulated.
+  void Add(const arma::mat& p1, const arma::mat& p2, const int first = 0,
+           int last = -1) {
+    if (p1.n_cols != p2.n_cols)
+      LOG(ERROR) << "Number of points of p1 and p2 must be consistent.";
+    if (p1.n_rows != 3 || p2.n_rows != 3)
+      LOG(ERROR) << "Points must be represented as homogeneous coordinates.";
+    if (last < 0) last = p1.n_cols;
+
+    double* QtQ = QtQ_.memptr();
+    for (int i = first; i < last; ++i) {
+      const double* x1 = p1.colptr(i);
+      const double* x2 = p2.colptr(i);
+      double a[3], b[3];
+      for (int r = 0; r < 3; ++r) {
+        a[r] = T1_(r, 0) * x1[0] + T1_(r, 1) * x1[1] + T1_(r, 2) * x1[2];
+        b[r] = T2_(r, 0) * x2[0] + T2_(r, 1) * x2[1] + T2_(r, 2) * x2[2];
+      }
+      // The row of Q, i.e. kron(a, b).
+      double q[9];
+      for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c) q[3 * r + c] = a[r] * b[c];
+      // Only the upper triangle is accumulated.
+      for (int c = 0; c < 9; ++c)
+        for (int r = 0; r <= c; ++r) QtQ[9 * c + r] += q[r] * q[c];
+    }
+    num_correspondences_ += last - first;
+  }
+
+  EpipolarNormalEquations& operator+=(const EpipolarNormalEquations& other) {
+    QtQ_ += other.QtQ_;
+    num_correspondences_ += other.num_correspondences_;
+    return *this;
+  }
+
+  int num_correspondences() const { return num_correspondences_; }
+
+  //@brief Solve for the fundamental matrix of the accumulated
+  // correspondences.
+  //@return F -- [3 x 3] fundamental matrix in the unnormalized coordinates,
+  // satisfying the singularity constraint det(F) = 0.
+  arma::mat /* F */
+  Solve() const {
+    if (num_correspondences_ < 8)
+      LOG(ERROR) << "Insufficient number of point correspondences.";
+
+    // The eigenvector of the smallest eigenvalue of Q' * Q is the right
+    // singular vector of the smallest singular value of Q.
+    arma::mat::fixed<9, 9> QtQ = arma::symmatu(QtQ_);
+    arma::vec eigenvalues;
+    arma::mat eigenvectors;
+    arma::eig_sym(eigenvalues, eigenvectors, QtQ);
+    //! The eigenvalues are sorted in ascending order.
+    arma::mat F_tilde = arma::reshape(eigenvectors.col(0), 3, 3);
+
+    // Enforce the singularity constraint, as in Fundamental8Point.
+    arma::vec s;
+    arma::mat U, V;
+    arma::svd(U, s, V, F_tilde);
+    s.tail(1) = 0;
+    F_tilde = U * arma::diagmat(s) * V.t();
+
+    return T2_.t() * F_tilde * T1_;
+  }
+
+ private:
+  arma::mat33 T1_, T2_;
+  arma::mat::fixed<9, 9> QtQ_;
+  int num_correspondences_ = 0;
+};
+
+//@brief Find fundamental matrix F from 2D point correspondences using the
+// normalized 8 point algorithm, accumulating the normal equations in parallel
+// instead of forming Q, see EpipolarNormalEquations.
+//! Equivalent to FundamentalNormalized8Point up to the precision of the
+//! normal equations, whose condition number is the square of that of Q, which
+//! the normalization keeps small. Meant for large sets of correspondences.
+//@param p1 [3 x n] matrix where each column contains the homogeneous
+// coordinates of image points p1 on the left camera.
+//@param p2 [3 x n] matrix where each column contains the homogeneous
+// coordinates of image points p2 on the right camera.
+//@param pool Thread pool on which the chunks are accumulated.
+//@return F -- [3 x 3] fundamental matrix encapsulating the two view geometry.
+arma::mat /* F */
+FundamentalNormalEquations8Point(
+    const arma::mat& p1, const arma::mat& p2,
+    uzh::ThreadPool& pool = uzh::ThreadPool::Global()) {
+  if (p1.n_cols != p2.n_cols)
+    LOG(ERROR) << "Number of points of p1 and p2 must be consistent.";
+  if (p1.n_rows != 3 || p2.n_rows != 3)
+    LOG(ERROR) << "Points must be represented as homogeneous coordinates.";
+  if (p1.n_cols < 8)
+    LOG(ERROR) << "Insufficient number of point correspondences.";
+
+  arma::mat T1, T2;
+  std::tie(std::ignore, T1) = NormalizePoints(p1);
+  std::tie(std::ignore, T2) = NormalizePoints(p2);
+
+  // Partial sums of the chunks, added up in order such that the result does
+  // not depend on the scheduling.
+  const int kNumPoints = p1.n_cols;
+  const int kNumChunks =
+      (kNumPoints + kNormalEquationsGrainSize - 1) / kNormalEquationsGrainSize;
+  std::vector<EpipolarNormalEquations> partial_sums(
+      kNumChunks, EpipolarNormalEquations(T1, T2));
+  pool.ParallelFor(
+      0, kNumChunks,
+      [&](const int chunk) {
+        const int kFirst = chunk * kNormalEquationsGrainSize;
+        partial_sums[chunk].Add(
+            p1, p2, kFirst,
+            std::min(kNumPoints, kFirst + kNormalEquationsGrainSize));
+      },
+      1);
+  EpipolarNormalEquations normal_equations(T1, T2);
+  for (const EpipolarNormalEquations& partial_sum : partial_sums)
+    normal_equations += partial_sum;
+  return normal_equations.Solve();
+}
+
+}  // namespace uzh
+
+#endif  // UZH_TWO_VIEW_GEOMETRY_EPIPOLAR_NORMAL_EQUATIONS_H_
@@ -0,0 +1,196 @@
+#ifndef UZH_TWO_VIEW_GEOMETRY_EPIPOLAR_RESIDUALS_H_
+#define UZH_TWO_VIEW_GEOMETRY_EPIPOLAR_RESIDUALS_H_
+
+#include <type_traits>  // std::integral_constant
+
+#include "armadillo"
+#include "parallel/simd_ops.h"
+
+namespace uzh {
+
+//@brief Squared epipolar residuals of a correspondence (x1, x2) wrt. the
+// essential or fundamental matrix F, with l2 = F * x1 and l1 = F' * x2 the
+// epipolar lines.
+enum EpipolarResidual : int {
+  EPIPOLAR_ALGEBRAIC,  // (x2' * F * x1)^2
+  EPIPOLAR_SAMPSON,    // (x2' * F * x1)^2 / (|l2_12|^2 + |l1_12|^2)
+  EPIPOLAR_SYMMETRIC   // (x2' * F * x1)^2 * (1 / |l2_12|^2 + 1 / |l1_12|^2)
+};
+
+//@brief Coefficients of a [3 x 3] matrix in row-major order, hoisted out of
+// the residual loops.
+struct EpipolarMatrixCoefficients {
+  double f00, f01, f02, f10, f11, f12, f20, f21, f22;
+
+  explicit EpipolarMatrixCoefficients(const arma::mat& F)
+      : f00(F(0, 0)), f01(F(0, 1)), f02(F(0, 2)),
+        f10(F(1, 0)), f11(F(1, 1)), f12(F(1, 2)),
+        f20(F(2, 0)), f21(F(2, 1)), f22(F(2, 2)) {}
+};
+
+namespace internal {
+
+//@brief F broadcast to the lanes of Ops::V.
+template <typename Ops>
+struct BroadcastCoefficients {
+  typename Ops::V f00, f01, f02, f10, f11, f12, f20, f21, f22;
+
+  explicit BroadcastCoefficients(const EpipolarMatrixCoefficients& F)
+      : f00(Ops::Set(F.f00)), f01(Ops::Set(F.f01)), f02(Ops::Set(F.f02)),
+        f10(Ops::Set(F.f10)), f11(Ops::Set(F.f11)), f12(Ops::Set(F.f12)),
+        f20(Ops::Set(F.f20)), f21(Ops::Set(F.f21)), f22(Ops::Set(F.f22)) {}
+};
+
+//@brief Squared residual kType of the correspondences in the lanes of x1, y1,
+// x2 and y2.
+template <int kType, typename Ops>
+inline typename Ops::V SquaredEpipolarResidual(
+    const BroadcastCoefficients<Ops>& F, const typename Ops::V x1,
+    const typename Ops::V y1, const typename Ops::V x2,
+    const typename Ops::V y2) {
+  using V = typename Ops::V;
+  // l2 = F * x1.
+  const V l2_0 = Ops::Add(Ops::Add(Ops::Mul(F.f00, x1), Ops::Mul(F.f01, y1)),
+                          F.f02);
+  const V l2_1 = Ops::Add(Ops::Add(Ops::Mul(F.f10, x1), Ops::Mul(F.f11, y1)),
+                          F.f12);
+  const V l2_2 = Ops::Add(Ops::Add(Ops::Mul(F.f20, x1), Ops::Mul(F.f21, y1)),
+                          F.f22);
+  const V kAlgebraic =
+      Ops::Add(Ops::Add(Ops::Mul(x2, l2_0), Ops::Mul(y2, l2_1)), l2_2);
+  const V kAlgebraic2 = Ops::Mul(kAlgebraic, kAlgebraic);
+  if (kType == EPIPOLAR_ALGEBRAIC) return kAlgebraic2;
+
+  // l1 = F' * x2.
+  const V l1_0 = Ops::Add(Ops::Add(Ops::Mul(F.f00, x2), Ops::Mul(F.f10, y2)),
+                          F.f20);
+  const V l1_1 = Ops::Add(Ops::Add(Ops::Mul(F.f01, x2), Ops::Mul(F.f11, y2)),
+                          F.f21);
+  const V kNorm2 = Ops::Add(Ops::Mul(l2_0, l2_0), Ops::Mul(l2_1, l2_1));
+  const V kNorm1 = Ops::Add(Ops::Mul(l1_0, l1_0), Ops::Mul(l1_1, l1_1));
+  if (kType == EPIPOLAR_SAMPSON)
+    return Ops::Div(kAlgebraic2, Ops::Add(kNorm1, kNorm2));
+  return Ops::Add(Ops::Div(kAlgebraic2, kNorm1),
+                  Ops::Div(kAlgebraic2, kNorm2));
+}
+
+//@brief Write the squared residuals of correspondences [first, n) with Ops.
+//@return The index of the first correspondence not processed, i.e. the
+// remainder left to the caller.
+template <int kType, typename Ops, typename T>
+inline int SquaredEpipolarResiduals(const EpipolarMatrixCoefficients& F,
+                                    const T* x1, const T* y1, const T* x2,
+                                    const T* y2, int first, const int n,
+                                    T* residuals) {
+  const BroadcastCoefficients<Ops> kF(F);
+  for (; first + Ops::kWidth <= n; first += Ops::kWidth) {
+    Ops::Store(residuals + first,
+               SquaredEpipolarResidual<kType, Ops>(
+                   kF, Ops::Load(x1 + first), Ops::Load(y1 + first),
+                   Ops::Load(x2 + first), Ops::Load(y2 + first)));
+  }
+  return first;
+}
+
+//@brief Count the correspondences [first, n) whose squared residual is below
+// squared_threshold with Ops.
+//@return The index of the first correspondence not processed.
+template <int kType, typename Ops, typename T>
+inline int CountEpipolarInliers(const EpipolarMatrixCoefficients& F,
+                                const T* x1, const T* y1, const T* x2,
+                                const T* y2, int first, const int n,
+                                const double squared_threshold,
+                                int* num_inliers) {
+  const BroadcastCoefficients<Ops> kF(F);
+  const typename Ops::V kThreshold = Ops::Set(squared_threshold);
+  int count = 0;
+  for (; first + Ops::kWidth <= n; first += Ops::kWidth) {
+    count += Ops::CountLess(
+        SquaredEpipolarResidual<kType, Ops>(
+            kF, Ops::Load(x1 + first), Ops::Load(y1 + first),
+            Ops::Load(x2 + first), Ops::Load(y2 + first)),
+        kThreshold);
+  }
+  *num_inliers += count;
+  return first;
+}
+
+}  // namespace internal
+
+//@brief Squared epipolar residuals of correspondences stored as structure of
+// arrays, i.e. the dehomogenized coordinates (x1, y1) on the left camera and
+// (x2, y2) on the right camera.
+//! With AVX2, 4 double or 8 float correspondences are evaluated at a time and
+//! the remainder by scalar code, which is also the fallback without AVX2.
+//! Float halves the memory traffic and doubles the lanes, which is precise
+//! enough for pixel or normalized coordinates.
+//@param F [3 x 3] essential or fundamental matrix, matching the coordinates.
+//@param type Residual to be evaluated.
+//@param n Number of correspondences.
+//@param residuals Output array of n squared residuals.
+template <typename T>
+void SquaredEpipolarResiduals(const arma::mat& F, const EpipolarResidual type,
+                              const T* x1, const T* y1, const T* x2,
+                              const T* y2, const int n, T* residuals) {
+  const EpipolarMatrixCoefficients kF(F);
+  const auto evaluate = [&](const auto type_tag) {
+    constexpr int kType = decltype(type_tag)::value;
+    int i = 0;
+#if defined(__AVX2__)
+    i = internal::SquaredEpipolarResiduals<kType, internal::Avx2Ops<T>>(
+        kF, x1, y1, x2, y2, i, n, residuals);
+#endif
+    internal::SquaredEpipolarResiduals<kType, internal::ScalarOps<T>>(
+        kF, x1, y1, x2, y2, i, n, residuals);
+  };
+  switch (type) {
+    case EPIPOLAR_ALGEBRAIC:
+      evaluate(std::integral_constant<int, EPIPOLAR_ALGEBRAIC>());
+      break;
+    case EPIPOLAR_SAMPSON:
+      evaluate(std::integral_constant<int, EPIPOLAR_SAMPSON>());
+      break;
+    case EPIPOLAR_SYMMETRIC:
+      evaluate(std::integral_constant<int, EPIPOLAR_SYMMETRIC>());
+      break;
+  }
+}
+
+//@brief Number of correspondences whose squared epipolar residual is below
+// squared_threshold, see SquaredEpipolarResiduals.
+//! This is the scoring loop of robust estimators. The residuals are compared
+//! in registers and only the count is kept, hence nothing is written to
+//! memory.
+template <typename T>
+int CountEpipolarInliers(const arma::mat& F, const EpipolarResidual type,
+                         const T* x1, const T* y1, const T* x2, const T* y2,
+                         const int n, const double squared_threshold) {
+  const EpipolarMatrixCoefficients kF(F);
+  int num_inliers = 0;
+  const auto count = [&](const auto type_tag) {
+    constexpr int kType = decltype(type_tag)::value;
+    int i = 0;
+#if defined(__AVX2__)
+    i = internal::CountEpipolarInliers<kType, internal::Avx2Ops<T>>(
+        kF, x1, y1, x2, y2, i, n, squared_threshold, &num_inliers);
+#endif
+    internal::CountEpipolarInliers<kType, internal::ScalarOps<T>>(
+        kF, x1, y1, x2, y2, i, n, squared_threshold, &num_inliers);
+  };
+  switch (type) {
+    case EPIPOLAR_ALGEBRAIC:
+      count(std::integral_constant<int, EPIPOLAR_ALGEBRAIC>());
+      break;
+    case EPIPOLAR_SAMPSON:
+      count(std::integral_constant<int, EPIPOLAR_SAMPSON>());
+      break;
+    case EPIPOLAR_SYMMETRIC:
+      count(std::integral_constant<int, EPIPOLAR_SYMMETRIC>());
+      break;
+  }
+  return num_inliers;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_TWO_VIEW_GEOMETRY_EPIPOLAR_RESIDUALS_H_
@@ -0,0 +1,317 @@
+#ifndef UZH_TWO_VIEW_GEOMETRY_ESSENTIAL_5POINT_H_
+#define UZH_TWO_VIEW_GEOMETRY_ESSENTIAL_5POINT_H_
+
+#include <algorithm>  // std::max
+#include <array>
+#include <cmath>
+#include <complex>
+
+#include "Eigen/Core"
+#include "Eigen/Eigenvalues"
+#include "Eigen/LU"
+#include "Eigen/QR"
+
+namespace uzh {
+
+// Maximum number of essential matrices consistent with 5 correspondences.
+constexpr int kMaxNumEssential5PointSolutions = 10;
+
+namespace internal {
+
+//! Polynomials in x, y and z of degree at most 3, stored densely by the
+//! exponents of x, y and z. Only the products needed for the constraints of
+//! the essential matrix, i.e. by a linear polynomial, are supported.
+struct CubicPolynomial {
+  double c[4][4][4] = {};
+};
+
+//@brief Product of p, of degree at most 2, and the linear polynomial
+// l[0] * x + l[1] * y + l[2] * z + l[3].
+inline CubicPolynomial MultiplyLinear(const CubicPolynomial& p,
+                                      const double* l) {
+  CubicPolynomial q;
+  for (int a = 0; a <= 2; ++a) {
+    for (int b = 0; a + b <= 2; ++b) {
+      for (int c = 0; a + b + c <= 2; ++c) {
+        const double kCoeff = p.c[a][b][c];
+        q.c[a + 1][b][c] += kCoeff * l[0];
+        q.c[a][b + 1][c] += kCoeff * l[1];
+        q.c[a][b][c + 1] += kCoeff * l[2];
+        q.c[a][b][c] += kCoeff * l[3];
+      }
+    }
+  }
+  return q;
+}
+
+//@brief Linear polynomial l[0] * x + l[1] * y + l[2] * z + l[3].
+inline CubicPolynomial LinearPolynomial(const double* l) {
+  CubicPolynomial p;
+  p.c[1][0][0] = l[0];
+  p.c[0][1][0] = l[1];
+  p.c[0][0][1] = l[2];
+  p.c[0][0][0] = l[3];
+  return p;
+}
+
+//@brief Coefficients of the polynomial p in z of degree A times those of q of
+// degree B, in increasing order of the powers.
+template <int A, int B>
+inline std::array<double, A + B + 1> MultiplyPolynomials(
+    const std::array<double, A + 1>& p, const std::array<double, B + 1>& q) {
+  std::array<double, A + B + 1> r{};
+  for (int i = 0; i <= A; ++i)
+    for (int j = 0; j <= B; ++j) r[i + j] += p[i] * q[j];
+  return r;
+}
+
+//@brief Value of the polynomial with coefficients p in increasing order of
+// the powers at z.
+template <std::size_t N>
+inline double EvaluatePolynomial(const std::array<double, N>& p,
+                                 const double z) {
+  double value = 0.0;
+  for (int i = N - 1; i >= 0; --i) value = value * z + p[i];
+  return value;
+}
+
+}  // namespace internal
+
+//@brief Find the essential matrices consistent with 5 calibrated point
+// correspondences with Nister's five-point algorithm.
+//! The 5 epipolar constraints q2' * E * q1 = 0 leave a 4-dimensional null space
+//! E = x * X + y * Y + z * Z + W. Substituting it into the cubic constraints
+//! det(E) = 0 and 2 * E * E' * E - trace(E * E') * E = 0 yields 10 equations in
+//! 20 monomials of x, y and z. After Gauss-Jordan elimination of the first 10
+//! monomials, subtracting z times some of the remaining equations from others
+//! leaves a [3 x 3] system in (x, y, 1) whose entries are polynomials in z. Its
+//! determinant is a polynomial of degree 10 whose real roots are the z of the
+//! solutions, found as the eigenvalues of its companion matrix. x and y follow
+//! from the null vector of the [3 x 3] system at each root.
+//! All matrices are fixed-size, hence the solver does not allocate, which makes
+//! it suitable for the inner loop of RANSAC.
+//@param q1 [3 x 5] matrix where each column is the bearing vector, i.e. the
+// homogeneous normalized image coordinates K1^-1 * p1 up to scale, of a point
+// on the left camera.
+//@param q2 [3 x 5] matrix where each column is the bearing vector of the
+// corresponding point on the right camera.
+//@param essential_matrices Array whose first returned number of entries are
+// set to the [3 x 3] essential matrices, each of unit Frobenius norm and
+// satisfying q2' * E * q1 = 0.
+//@return Number of solutions, at most kMaxNumEssential5PointSolutions.
+//@ref D. Nister, An efficient solution to the five-point relative pose problem,
+// TPAMI 2004.
+int Essential5Point(
+    const Eigen::Matrix<double, 3, 5>& q1,
+    const Eigen::Matrix<double, 3, 5>& q2,
+    std::array<Eigen::Matrix3d, kMaxNumEssential5PointSolutions>*
+        essential_matrices) {
+  // Each correspondence contributes a row of Q such that Q * vec(E) = 0, where
+  // vec(E) stacks the columns of E, as in Fundamental8Point.
+  Eigen::Matrix<double, 9, 5> Qt;
+  for (int i = 0; i < 5; ++i) {
+    for (int a = 0; a < 3; ++a)
+      for (int b = 0; b < 3; ++b) Qt(3 * a + b, i) = q1(a, i) * q2(b, i);
+  }
+  // The last 4 columns of the orthogonal factor of Q' span the null space.
+  const Eigen::HouseholderQR<Eigen::Matrix<double, 9, 5>> kQR(Qt);
+  const Eigen::Matrix<double, 9, 9> kBasis = kQR.householderQ();
+
+  // Entries of E as linear polynomials in x, y and z.
+  double E[3][3][4];
+  for (int a = 0; a < 3; ++a) {
+    for (int b = 0; b < 3; ++b) {
+      for (int k = 0; k < 4; ++k) E[b][a][k] = kBasis(3 * a + b, 5 + k);
+    }
+  }
+
+  // The 10 cubic constraints.
+  std::array<internal::CubicPolynomial, 10> constraints;
+  {
+    using internal::CubicPolynomial;
+    // det(E) expanded along the first row.
+    const auto minor = [&E](const int r0, const int c0, const int r1,
+                            const int c1) {
+      CubicPolynomial p = internal::MultiplyLinear(
+          internal::LinearPolynomial(E[r0][c0]), E[r1][c1]);
+      const CubicPolynomial q = internal::MultiplyLinear(
+          internal::LinearPolynomial(E[r0][c1]), E[r1][c0]);
+      for (int a = 0; a < 4; ++a)
+        for (int b = 0; b < 4; ++b)
+          for (int c = 0; c < 4; ++c) p.c[a][b][c] -= q.c[a][b][c];
+      return p;
+    };
+    const CubicPolynomial kDet[3] = {
+        internal::MultiplyLinear(minor(1, 1, 2, 2), E[0][0]),
+        internal::MultiplyLinear(minor(1, 0, 2, 2), E[0][1]),
+        internal::MultiplyLinear(minor(1, 0, 2, 1), E[0][2])};
+    for (int a = 0; a < 4; ++a)
+      for (int b = 0; b < 4; ++b)
+        for (int c = 0; c < 4; ++c)
+          constraints[0].c[a][b][c] =
+              kDet[0].c[a][b][c] - kDet[1].c[a][b][c] + kDet[2].c[a][b][c];
+
+    // E * E', which is symmetric, and its trace.
+    CubicPolynomial EEt[3][3];
+    for (int i = 0; i < 3; ++i) {
+      for (int j = i; j < 3; ++j) {
+        for (int k = 0; k < 3; ++k) {
+          const CubicPolynomial kTerm = internal::MultiplyLinear(
+              internal::LinearPolynomial(E[i][k]), E[j][k]);
+          for (int a = 0; a <= 2; ++a)
+            for (int b = 0; a + b <= 2; ++b)
+              for (int c = 0; a + b + c <= 2; ++c)
+                EEt[i][j].c[a][b][c] += kTerm.c[a][b][c];
+        }
+        EEt[j][i] = EEt[i][j];
+      }
+    }
+    CubicPolynomial trace;
+    for (int a = 0; a <= 2; ++a)
+      for (int b = 0; a + b <= 2; ++b)
+        for (int c = 0; a + b + c <= 2; ++c)
+          trace.c[a][b][c] = EEt[0][0].c[a][b][c] + EEt[1][1].c[a][b][c] +
+                             EEt[2][2].c[a][b][c];
+
+    // 2 * E * E' * E - trace(E * E') * E = 0.
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        CubicPolynomial& p = constraints[1 + 3 * i + j];
+        for (int k = 0; k < 3; ++k) {
+          const CubicPolynomial kTerm =
+              internal::MultiplyLinear(EEt[i][k], E[k][j]);
+          for (int a = 0; a < 4; ++a)
+            for (int b = 0; b < 4; ++b)
+              for (int c = 0; c < 4; ++c) p.c[a][b][c] += 2 * kTerm.c[a][b][c];
+        }
+        const CubicPolynomial kTerm = internal::MultiplyLinear(trace, E[i][j]);
+        for (int a = 0; a < 4; ++a)
+          for (int b = 0; b < 4; ++b)
+            for (int c = 0; c < 4; ++c) p.c[a][b][c] -= kTerm.c[a][b][c];
+      }
+    }
+  }
+
+  // Exponents of x, y and z of the 20 monomials in Nister's order:
+  // x^3, y^3, x^2y, xy^2, x^2z, x^2, y^2z, y^2, xyz, xy, followed by the
+  // monomials xz^2, xz, x, yz^2, yz, y, z^3, z^2, z, 1 remaining after the
+  // elimination.
+  constexpr int kMonomials[20][3] = {
+      {3, 0, 0}, {0, 3, 0}, {2, 1, 0}, {1, 2, 0}, {2, 0, 1},
+      {2, 0, 0}, {0, 2, 1}, {0, 2, 0}, {1, 1, 1}, {1, 1, 0},
+      {1, 0, 2}, {1, 0, 1}, {1, 0, 0}, {0, 1, 2}, {0, 1, 1},
+      {0, 1, 0}, {0, 0, 3}, {0, 0, 2}, {0, 0, 1}, {0, 0, 0}};
+  Eigen::Matrix<double, 10, 20> A;
+  for (int i = 0; i < 10; ++i) {
+    for (int j = 0; j < 20; ++j) {
+      A(i, j) = constraints[i]
+                    .c[kMonomials[j][0]][kMonomials[j][1]][kMonomials[j][2]];
+    }
+  }
+  // Gauss-Jordan elimination: row i of B reads
+  // monomial_i + B.row(i) * [xz^2, xz, x, yz^2, yz, y, z^3, z^2, z, 1]' = 0.
+  const Eigen::Matrix<double, 10, 10> B =
+      A.leftCols<10>().partialPivLu().solve(A.rightCols<10>());
+
+  // Row r of B as x * [x] + y * [y] + [1] with polynomials in z.
+  const auto x_part = [&B](const int r) {
+    return std::array<double, 3>{B(r, 2), B(r, 1), B(r, 0)};
+  };
+  const auto y_part = [&B](const int r) {
+    return std::array<double, 3>{B(r, 5), B(r, 4), B(r, 3)};
+  };
+  const auto one_part = [&B](const int r) {
+    return std::array<double, 4>{B(r, 9), B(r, 8), B(r, 7), B(r, 6)};
+  };
+  // Row r0 minus z times row r1, which cancels their leading monomials.
+  //! x^2z - z * x^2, y^2z - z * y^2 and xyz - z * xy.
+  using Cubic = std::array<double, 4>;
+  using Quartic = std::array<double, 5>;
+  Cubic M_x[3], M_y[3];
+  Quartic M_1[3];
+  const int kRows[3][2] = {{4, 5}, {6, 7}, {8, 9}};
+  for (int i = 0; i < 3; ++i) {
+    const int r0 = kRows[i][0], r1 = kRows[i][1];
+    const auto x0 = x_part(r0), x1 = x_part(r1);
+    const auto y0 = y_part(r0), y1 = y_part(r1);
+    const auto one0 = one_part(r0), one1 = one_part(r1);
+    M_x[i] = {x0[0], x0[1] - x1[0], x0[2] - x1[1], -x1[2]};
+    M_y[i] = {y0[0], y0[1] - y1[0], y0[2] - y1[1], -y1[2]};
+    M_1[i] = {one0[0], one0[1] - one1[0], one0[2] - one1[1],
+              one0[3] - one1[2], -one1[3]};
+  }
+
+  // det(M) expanded along the first row.
+  using internal::MultiplyPolynomials;
+  const auto kCofactor_x = MultiplyPolynomials<3, 4>(M_y[1], M_1[2]);
+  const auto kCofactor_x_ = MultiplyPolynomials<4, 3>(M_1[1], M_y[2]);
+  const auto kCofactor_y = MultiplyPolynomials<3, 4>(M_x[1], M_1[2]);
+  const auto kCofactor_y_ = MultiplyPolynomials<4, 3>(M_1[1], M_x[2]);
+  const auto kCofactor_1 = MultiplyPolynomials<3, 3>(M_x[1], M_y[2]);
+  const auto kCofactor_1_ = MultiplyPolynomials<3, 3>(M_y[1], M_x[2]);
+  std::array<double, 8> cofactor_x, cofactor_y;
+  std::array<double, 7> cofactor_1;
+  for (int i = 0; i < 8; ++i) {
+    cofactor_x[i] = kCofactor_x[i] - kCofactor_x_[i];
+    cofactor_y[i] = kCofactor_y[i] - kCofactor_y_[i];
+  }
+  for (int i = 0; i < 7; ++i) cofactor_1[i] = kCofactor_1[i] - kCofactor_1_[i];
+  const auto kTerm_x = MultiplyPolynomials<3, 7>(M_x[0], cofactor_x);
+  const auto kTerm_y = MultiplyPolynomials<3, 7>(M_y[0], cofactor_y);
+  const auto kTerm_1 = MultiplyPolynomials<4, 6>(M_1[0], cofactor_1);
+  std::array<double, 11> n;
+  for (int i = 0; i < 11; ++i) n[i] = kTerm_x[i] - kTerm_y[i] + kTerm_1[i];
+
+  // Real roots of n as the eigenvalues of its companion matrix. The degree
+  // drops if the leading coefficients vanish.
+  double max_coeff = 0.0;
+  for (const double kCoeff : n)
+    max_coeff = std::max(max_coeff, std::abs(kCoeff));
+  int degree = 10;
+  while (degree > 0 && std::abs(n[degree]) <= 1e-12 * max_coeff) --degree;
+  if (degree == 0) return 0;
+  using CompanionMatrix =
+      Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, 0, 10, 10>;
+  CompanionMatrix C = CompanionMatrix::Zero(degree, degree);
+  C.bottomLeftCorner(degree - 1, degree - 1).setIdentity();
+  for (int i = 0; i < degree; ++i) C(i, degree - 1) = -n[i] / n[degree];
+  const Eigen::EigenSolver<CompanionMatrix> kEigenSolver(C, false);
+
+  int num_solutions = 0;
+  for (int k = 0; k < degree; ++k) {
+    const std::complex<double> kRoot = kEigenSolver.eigenvalues()(k);
+    if (std::abs(kRoot.imag()) > 1e-10 * std::max(1.0, std::abs(kRoot.real())))
+      continue;
+    const double z = kRoot.real();
+
+    // (x, y, 1) is the null vector of M(z), i.e. the cross product of two of
+    // its rows. The pair with the largest cross product is the best
+    // conditioned.
+    Eigen::Matrix3d M;
+    for (int i = 0; i < 3; ++i) {
+      M(i, 0) = internal::EvaluatePolynomial(M_x[i], z);
+      M(i, 1) = internal::EvaluatePolynomial(M_y[i], z);
+      M(i, 2) = internal::EvaluatePolynomial(M_1[i], z);
+    }
+    Eigen::Vector3d v = M.row(0).cross(M.row(1));
+    const Eigen::Vector3d kV02 = M.row(0).cross(M.row(2));
+    const Eigen::Vector3d kV12 = M.row(1).cross(M.row(2));
+    if (kV02.squaredNorm() > v.squaredNorm()) v = kV02;
+    if (kV12.squaredNorm() > v.squaredNorm()) v = kV12;
+    if (v(2) == 0) continue;
+    const double x = v(0) / v(2), y = v(1) / v(2);
+
+    Eigen::Matrix3d& essential = (*essential_matrices)[num_solutions++];
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c)
+        essential(r, c) = x * E[r][c][0] + y * E[r][c][1] + z * E[r][c][2] +
+                          E[r][c][3];
+    }
+    essential.normalize();
+  }
+  return num_solutions;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_TWO_VIEW_GEOMETRY_ESSENTIAL_5POINT_H_
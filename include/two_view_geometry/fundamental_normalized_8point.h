@@ -5,11 +5,16 @@
 
 #include "armadillo"
 #include "glog/logging.h"
+#include "two_view_geometry/epipolar_normal_equations.h"
 #include "two_view_geometry/fundamental_8point.h"
 #include "two_view_geometry/normalize_points.h"
 
 namespace uzh {
 
+// Number of correspondences from which FundamentalNormalized8Point accumulates
+// the normal equations instead of taking the SVD of Q.
+constexpr int kNormalEquations8PointMinPoints = 2048;
+
 //@brief Find fundamental matrix F from 2D point correspondences using 8 point
 // algorithm with normalized coordinates.
 //@param p1 [3 x n] matrix where each column contains the homogeneous
@@ -21,6 +26,8 @@ namespace uzh {
 //! independent linear equation involving p1, p2 and F.
 //! In the end of the function, a posteriori enforcement is applied to enforce
 //! the singularity constraint: det(F) = 0, since F is not full rank
+//! For kNormalEquations8PointMinPoints or more correspondences, the SVD of the
+//! tall matrix Q dominates, hence FundamentalNormalEquations8Point is used.
 arma::mat /* F */
 FundamentalNormalized8Point(const arma::mat& p1, const arma::mat& p2) {
   if (p1.n_cols != p2.n_cols)
@@ -30,6 +37,9 @@ FundamentalNormalized8Point(const arma::mat& p1, const arma::mat& p2) {
   if (p1.n_cols < 8)
     LOG(ERROR) << "Insufficient number of point correspondences.";
 
+  if (p1.n_cols >= kNormalEquations8PointMinPoints)
+    return FundamentalNormalEquations8Point(p1, p2);
+
   // Normalize the two sets of points.
   arma::mat normalized_p1, normalized_p2, T1, T2;
   std::tie(normalized_p1, T1) = NormalizePoints(p1);
@@ -8,6 +8,8 @@
 #include "armadillo"
 #include "ceres/ceres.h"
 #include "glog/logging.h"
+#include "two_view_geometry/refine_triangulation.h"
+#include "two_view_geometry/sampson_distance.h"
 #include "two_view_geometry/triangulation.h"
 
 namespace uzh {
@@ -67,14 +69,23 @@ struct ReprojectionError {
 //@param M2 [3 x 4] matrix representing the projection matrix K[R|t] where it is
 // assumed the calibration matrices K1 = K2 = K for the left and right camera
 // respectively.
+//@param use_ceres Whether to solve a single ceres problem over all points
+// instead of refining each point on its own.
 //@return P -- [4 x n] matrix where each column contains the homogeneous
 // coordinates
 // for a 3D scene point P.
 //! In practice, this function takes as initial estimate the result of
 //! LinearTriangulation.
+//! With M1 and M2 fixed, the points do not share any parameter, hence by
+//! default each point is refined by a few Levenberg-Marquardt iterations of
+//! its own, see BatchNonlinearTriangulation, which avoids building the ceres
+//! problem altogether. The ceres path is kept for reference and as the
+//! starting point of problems which do couple the points, e.g. refining the
+//! cameras as well.
 arma::mat /* P */
 NonlinearTriangulation(const arma::mat& p1, const arma::mat& p2,
-                       const arma::mat& M1, const arma::mat& M2) {
+                       const arma::mat& M1, const arma::mat& M2,
+                       const bool use_ceres = false) {
   if (p1.n_cols != p2.n_cols)
     LOG(ERROR) << "Number of points of p1 and p2 must be consistent.";
   if (p1.n_rows != 3 || p2.n_rows != 3)
@@ -82,6 +93,15 @@ NonlinearTriangulation(const arma::mat& p1, const arma::mat& p2,
   if (M1.n_rows != 3 || M1.n_cols != 4 || M2.n_rows != 3 || M2.n_cols != 4)
     LOG(ERROR) << "Invalid projection matrix.";
 
+  if (!use_ceres) {
+    int num_refined = 0;
+    const arma::mat P = uzh::BatchNonlinearTriangulation(
+        uzh::PackEpipolarCorrespondences(p1, p2), M1, M2, &num_refined);
+    LOG(INFO) << "Refined " << num_refined << " out of " << P.n_cols
+              << " points.";
+    return P;
+  }
+
   // Obtain the initial estimate of P from LinearTriangulation function.
   const arma::mat& P_init = LinearTriangulation(p1, p2, M1, M2);
 
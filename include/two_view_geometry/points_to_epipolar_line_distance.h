@@ -1,8 +1,13 @@
 #ifndef UZH_TWO_VIEW_GEOMETRY_POINTS_TO_EPIPOLAR_LINE_DISTANCE_H_
 #define UZH_TWO_VIEW_GEOMETRY_POINTS_TO_EPIPOLAR_LINE_DISTANCE_H_
 
+#include <cmath>
+#include <vector>
+
 #include "armadillo"
 #include "glog/logging.h"
+#include "two_view_geometry/epipolar_residuals.h"
+#include "two_view_geometry/sampson_distance.h"
 
 namespace uzh {
 
@@ -16,13 +21,30 @@ namespace uzh {
 // uncalibrated space.
 //@return rms_distance RMS distance between the image points and the epipolar
 // line normalized by the number of point correspondences.
+//! The squared distances of p1 to F' * p2 and of p2 to F * p1 are the
+//! symmetric epipolar residuals, see SquaredEpipolarResiduals.
 double /* rms_distance */
 PointsToEpipolarLineDistance(const arma::mat& p1, const arma::mat& p2,
                              const arma::mat& F) {
-  // TODO(bayes)
-  // assert size.
+  if (p1.n_cols != p2.n_cols)
+    LOG(ERROR) << "Number of points of p1 and p2 must be consistent.";
+  if (p1.n_rows != 3 || p2.n_rows != 3)
+    LOG(ERROR) << "Points must be represented as homogeneous coordinates.";
+  if (F.n_rows != 3 || F.n_cols != 3) LOG(ERROR) << "Invalid F.";
+  if (p1.empty()) return 0;
 
-  return 0;
+  const uzh::EpipolarCorrespondences correspondences =
+      uzh::PackEpipolarCorrespondences(p1, p2);
+  std::vector<double> squared_distances(correspondences.size());
+  uzh::SquaredEpipolarResiduals(
+      F, EPIPOLAR_SYMMETRIC, correspondences.x1.data(),
+      correspondences.y1.data(), correspondences.x2.data(),
+      correspondences.y2.data(), correspondences.size(),
+      squared_distances.data());
+  double sum = 0.0;
+  for (const double kSquaredDistance : squared_distances)
+    sum += kSquaredDistance;
+  return std::sqrt(sum / correspondences.size());
 }
 
 }  // namespace uzh
@@ -0,0 +1,186 @@
+#ifndef UZH_TWO_VIEW_GEOMETRY_RANSAC_ESSENTIAL_MATRIX_H_
+#define UZH_TWO_VIEW_GEOMETRY_RANSAC_ESSENTIAL_MATRIX_H_
+
+#include <algorithm>  // std::min, std::max
+#include <array>
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "Eigen/Core"
+#include "parallel/thread_pool.h"
+#include "two_view_geometry/essential_5point.h"
+#include "two_view_geometry/fundamental_normalized_8point.h"
+#include "two_view_geometry/sampson_distance.h"
+
+namespace uzh {
+
+//@brief Project a [3 x 3] matrix onto the space of essential matrices, i.e.
+// replace its singular values by (s, s, 0) with s the mean of the first two.
+arma::mat /* E */
+EnforceEssentialConstraints(const arma::mat& E) {
+  arma::vec s;
+  arma::mat U, V;
+  arma::svd(U, s, V, E);
+  const double kMean = (s(0) + s(1)) / 2;
+  return U * arma::diagmat(arma::vec{kMean, kMean, 0}) * V.t();
+}
+
+//@brief Robustly estimate the essential matrix with RANSAC.
+//! Each sample of 5 correspondences yields up to 10 hypotheses from the
+//! five-point algorithm in normalized image coordinates, see Essential5Point,
+//! each scored by the number of correspondences whose Sampson distance is
+//! within pixel_tolerance. The Sampson distances are evaluated over the
+//! correspondences stored as structure of arrays, see CountSampsonInliers.
+//! Samples are drawn and scored in batches in parallel. Each sample is drawn
+//! from its own generator seeded by its index, hence the result does not
+//! depend on the number of threads. After each batch the number of iterations
+//! is adapted to the inlier ratio found so far. Finally, E is re-estimated
+//! from all inliers of the best hypothesis.
+//@param p1 [3 x n] matrix where each column contains the homogeneous
+// coordinates of image points p1 on the left camera.
+//@param p2 [3 x n] matrix where each column contains the homogeneous
+// coordinates of image points p2 on the right camera.
+//@param K1 [3 x 3] calibration matrix for the left camera.
+//@param K2 [3 x 3] calibration matrix for the right camera.
+//@param pixel_tolerance Sampson distance in pixels within which a
+// correspondence is an inlier. It is converted to normalized image coordinates
+// with the mean focal length of K1 and K2.
+//@param confidence Probability with which at least one sample is outlier-free
+// when the iterations stop.
+//@param max_iterations Upper bound of the number of samples.
+//@param pool Thread pool on which the samples are scored.
+//@return E -- [3 x 3] essential matrix; inlier_mask -- [1 x n] row vector
+// where each entry is 1 if the corresponding correspondence is an inlier of E
+// and 0 otherwise.
+std::tuple<arma::mat /* E */, arma::urowvec /* inlier_mask */>
+EstimateEssentialMatrixRANSAC(
+    const arma::mat& p1, const arma::mat& p2, const arma::mat& K1,
+    const arma::mat& K2, const double pixel_tolerance = 1.0,
+    const double confidence = 0.99, const int max_iterations = 5000,
+    uzh::ThreadPool& pool = uzh::ThreadPool::Global()) {
+  if (p1.n_cols != p2.n_cols)
+    LOG(ERROR) << "Number of points of p1 and p2 must be consistent.";
+  if (p1.n_rows != 3 || p2.n_rows != 3)
+    LOG(ERROR) << "Points must be represented as homogeneous coordinates.";
+  if (K1.n_rows != 3 || K1.n_cols != 3 || K2.n_rows != 3 || K2.n_cols != 3)
+    LOG(ERROR) << "Invalid calibration matrix.";
+
+  constexpr int kSampleSize = 5;
+  const int kNumPoints = p1.n_cols;
+  if (kNumPoints < kSampleSize) {
+    LOG(ERROR) << "Insufficient number of point correspondences.";
+    return {arma::mat(3, 3, arma::fill::zeros),
+            arma::urowvec(kNumPoints, arma::fill::zeros)};
+  }
+
+  // Normalized image coordinates, in which E relates the points.
+  const arma::mat q1 = arma::solve(K1, p1);
+  const arma::mat q2 = arma::solve(K2, p2);
+  const uzh::EpipolarCorrespondences correspondences =
+      uzh::PackEpipolarCorrespondences(q1, q2);
+  const double kFocalLength = (K1(0, 0) + K1(1, 1) + K2(0, 0) + K2(1, 1)) / 4;
+  const double kSquaredThreshold = std::pow(pixel_tolerance / kFocalLength, 2);
+
+  // E stays zero, as returned when the points are insufficient, unless an
+  // inlier is found.
+  struct Hypothesis {
+    arma::mat E = arma::mat(3, 3, arma::fill::zeros);
+    int num_inliers = 0;
+  };
+  const auto evaluate_hypothesis = [&](const int index,
+                                       Hypothesis* hypothesis) {
+    // Draw kSampleSize distinct correspondences.
+    std::mt19937 generator(index);
+    std::uniform_int_distribution<int> distribution(0, kNumPoints - 1);
+    arma::uvec sample(kSampleSize);
+    for (int k = 0; k < kSampleSize; ++k) {
+      int i;
+      do {
+        i = distribution(generator);
+      } while (arma::any(sample.head(k) == static_cast<arma::uword>(i)));
+      sample(k) = i;
+    }
+    Eigen::Matrix<double, 3, kSampleSize> sample1, sample2;
+    for (int k = 0; k < kSampleSize; ++k) {
+      for (int r = 0; r < 3; ++r) {
+        sample1(r, k) = q1(r, sample(k));
+        sample2(r, k) = q2(r, sample(k));
+      }
+    }
+    // Keep the best of the up to 10 solutions.
+    std::array<Eigen::Matrix3d, kMaxNumEssential5PointSolutions> solutions;
+    const int kNumSolutions =
+        uzh::Essential5Point(sample1, sample2, &solutions);
+    hypothesis->num_inliers = 0;
+    for (int s = 0; s < kNumSolutions; ++s) {
+      const arma::mat E(solutions[s].data(), 3, 3);
+      const int kNumInliers =
+          uzh::CountSampsonInliers(E, correspondences, kSquaredThreshold);
+      if (kNumInliers > hypothesis->num_inliers) {
+        hypothesis->E = E;
+        hypothesis->num_inliers = kNumInliers;
+      }
+    }
+  };
+
+  Hypothesis best;
+  double num_iterations = max_iterations;
+  const int kBatchSize = 4 * pool.size();
+  std::vector<Hypothesis> batch(kBatchSize);
+  int k = 0;
+  while (k < num_iterations) {
+    const int kNumHypotheses =
+        std::min(kBatchSize, static_cast<int>(std::ceil(num_iterations)) - k);
+    pool.ParallelFor(
+        0, kNumHypotheses,
+        [&](const int i) { evaluate_hypothesis(k + i, &batch[i]); }, 1);
+    //! Ties are broken by the index, hence the result is deterministic.
+    for (int i = 0; i < kNumHypotheses; ++i) {
+      if (batch[i].num_inliers > best.num_inliers) best = batch[i];
+    }
+    k += kNumHypotheses;
+
+    // Adapt the number of iterations to the inlier ratio found so far.
+    const double kInlierRatio = best.num_inliers / double(kNumPoints);
+    const double kAllInliers = std::pow(kInlierRatio, kSampleSize);
+    if (kAllInliers >= 1) break;
+    if (kAllInliers > 0) {
+      num_iterations = std::min<double>(
+          max_iterations,
+          std::log(1 - confidence) / std::log(1 - kAllInliers));
+    }
+  }
+
+  if (best.num_inliers < kSampleSize) {
+    LOG(WARNING) << "RANSAC found no consensus set.";
+    return {best.E, arma::urowvec(kNumPoints, arma::fill::zeros)};
+  }
+
+  // Re-estimate E from all inliers of the best hypothesis, and update the
+  // inliers accordingly.
+  std::vector<double> distances(kNumPoints);
+  uzh::SquaredSampsonDistances(best.E, correspondences, distances.data());
+  arma::urowvec inlier_mask(kNumPoints);
+  for (int i = 0; i < kNumPoints; ++i)
+    inlier_mask(i) = distances[i] < kSquaredThreshold;
+  const arma::uvec kInliers = arma::find(inlier_mask);
+  //! The least squares fit needs at least 8 correspondences.
+  if (kInliers.n_elem < 8) return {best.E, inlier_mask};
+  const arma::mat E = uzh::EnforceEssentialConstraints(
+      uzh::FundamentalNormalized8Point(q1.cols(kInliers), q2.cols(kInliers)));
+  uzh::SquaredSampsonDistances(E, correspondences, distances.data());
+  arma::urowvec refined_mask(kNumPoints);
+  for (int i = 0; i < kNumPoints; ++i)
+    refined_mask(i) = distances[i] < kSquaredThreshold;
+  // Keep the refined E only if it does not lose inliers.
+  if (arma::accu(refined_mask) < kInliers.n_elem) return {best.E, inlier_mask};
+  return {E, refined_mask};
+}
+
+}  // namespace uzh
+
+#endif  // UZH_TWO_VIEW_GEOMETRY_RANSAC_ESSENTIAL_MATRIX_H_
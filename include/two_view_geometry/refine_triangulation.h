@@ -0,0 +1,158 @@
+#ifndef UZH_TWO_VIEW_GEOMETRY_REFINE_TRIANGULATION_H_
+#define UZH_TWO_VIEW_GEOMETRY_REFINE_TRIANGULATION_H_
+
+#include <algorithm>  // std::min
+#include <atomic>
+#include <cmath>
+
+#include "Eigen/Cholesky"
+#include "Eigen/Core"
+#include "armadillo"
+#include "glog/logging.h"
+#include "parallel/thread_pool.h"
+#include "two_view_geometry/batch_triangulation.h"
+#include "two_view_geometry/sampson_distance.h"
+
+namespace uzh {
+
+// Maximum number of Levenberg-Marquardt iterations per point.
+constexpr int kTriangulationMaxIterations = 10;
+
+//@brief Minimize the reprojection error of one 3D scene point observed by two
+// cameras with Levenberg-Marquardt, see NonlinearTriangulation.
+//! The point is a 3-parameter problem independent of all other points, hence
+//! the [2 x 3] Jacobians of the projections are computed analytically,
+//! d(m_r * X / m_2 * X) / dX = (m_r - u_r * m_2) / (m_2 * X) with m_r the r-th
+//! row of M restricted to the first three columns, and the [3 x 3] damped
+//! normal equations are solved with a fixed-size Cholesky decomposition.
+//! Nothing is allocated.
+//@param M1 [3 x 4] projection matrix of the left camera in column-major order.
+//@param M2 [3 x 4] projection matrix of the right camera in column-major order.
+//@param X Initial estimate of the inhomogeneous coordinates of the 3D scene
+// point, refined in place.
+//@param max_iterations Maximum number of iterations.
+//@return False if the point is behind a camera or the refinement diverges, in
+// which case X is left unchanged.
+inline bool RefinePoint(
+    const double* M1, const double* M2, const double x1, const double y1,
+    const double x2, const double y2, double* X,
+    const int max_iterations = kTriangulationMaxIterations) {
+  const Eigen::Map<const Eigen::Matrix<double, 3, 4>> kM[2] = {
+      Eigen::Map<const Eigen::Matrix<double, 3, 4>>(M1),
+      Eigen::Map<const Eigen::Matrix<double, 3, 4>>(M2)};
+  const double kObserved[2][2] = {{x1, y1}, {x2, y2}};
+
+  // Squared reprojection error at P, and optionally its Jacobian J and the
+  // residuals e, i.e. the reprojected minus the observed image points.
+  const auto evaluate = [&](const Eigen::Vector3d& P,
+                            Eigen::Matrix<double, 4, 3>* J,
+                            Eigen::Vector4d* e) {
+    double cost = 0.0;
+    for (int v = 0; v < 2; ++v) {
+      const Eigen::Vector3d kProjection =
+          kM[v].leftCols<3>() * P + kM[v].col(3);
+      if (!(kProjection(2) > 0)) return -1.0;
+      const double kInvDepth = 1.0 / kProjection(2);
+      const double u = kProjection(0) * kInvDepth;
+      const double w = kProjection(1) * kInvDepth;
+      const double kResidual[2] = {u - kObserved[v][0], w - kObserved[v][1]};
+      cost += kResidual[0] * kResidual[0] + kResidual[1] * kResidual[1];
+      if (J == nullptr) continue;
+      (*e)(2 * v) = kResidual[0];
+      (*e)(2 * v + 1) = kResidual[1];
+      J->row(2 * v) =
+          (kM[v].row(0).head<3>() - u * kM[v].row(2).head<3>()) * kInvDepth;
+      J->row(2 * v + 1) =
+          (kM[v].row(1).head<3>() - w * kM[v].row(2).head<3>()) * kInvDepth;
+    }
+    return cost;
+  };
+
+  Eigen::Vector3d P(X[0], X[1], X[2]);
+  Eigen::Matrix<double, 4, 3> J;
+  Eigen::Vector4d e;
+  double cost = evaluate(P, &J, &e);
+  if (cost < 0) return false;
+
+  double lambda = 1e-3;
+  for (int iteration = 0; iteration < max_iterations; ++iteration) {
+    const Eigen::Matrix3d kJtJ = J.transpose() * J;
+    const Eigen::Vector3d kJte = J.transpose() * e;
+    // Damp until the cost decreases.
+    bool is_improved = false;
+    Eigen::Vector3d delta;
+    while (!is_improved && lambda < 1e10) {
+      Eigen::Matrix3d A = kJtJ;
+      A.diagonal() *= 1 + lambda;
+      delta = -A.ldlt().solve(kJte);
+      const double kNewCost = evaluate(P + delta, nullptr, nullptr);
+      is_improved = kNewCost >= 0 && kNewCost < cost;
+      lambda = is_improved ? lambda / 10 : lambda * 10;
+    }
+    if (!is_improved) break;
+    P += delta;
+    const double kOldCost = cost;
+    cost = evaluate(P, &J, &e);
+    // Stop once the step or the decrease is negligible.
+    if (delta.norm() <= 1e-12 * (P.norm() + 1e-12) ||
+        kOldCost - cost <= 1e-12 * kOldCost)
+      break;
+  }
+  if (!P.allFinite()) return false;
+  X[0] = P(0);
+  X[1] = P(1);
+  X[2] = P(2);
+  return true;
+}
+
+//@brief Nonlinear triangulation of all correspondences in parallel, where
+// each 3D scene point is initialized by TriangulatePoint and refined by
+// RefinePoint, see NonlinearTriangulation.
+//! With both projection matrices fixed the points are decoupled, hence no
+//! global problem is built.
+//@param correspondences Correspondences from PackEpipolarCorrespondences.
+//@param M1 [3 x 4] projection matrix K1[I|0] for the left camera.
+//@param M2 [3 x 4] projection matrix K2[R|t] for the right camera.
+//@param num_refined If not nullptr, set to the number of points refined,
+// while the others keep the linear estimate.
+//@param pool Thread pool across whose workers the points are split.
+//@return P -- [4 x n] matrix where each column contains the homogeneous
+// coordinates for a 3D scene point P in the left camera frame.
+arma::mat /* P */
+BatchNonlinearTriangulation(
+    const uzh::EpipolarCorrespondences& correspondences, const arma::mat& M1,
+    const arma::mat& M2, int* num_refined = nullptr,
+    uzh::ThreadPool& pool = uzh::ThreadPool::Global()) {
+  if (M1.n_rows != 3 || M1.n_cols != 4 || M2.n_rows != 3 || M2.n_cols != 4)
+    LOG(ERROR) << "Invalid projection matrix.";
+
+  const int kNumPoints = correspondences.size();
+  const int kNumChunks =
+      (kNumPoints + kTriangulationGrainSize - 1) / kTriangulationGrainSize;
+  arma::mat P(4, kNumPoints);
+  std::atomic<int> num_points_refined{0};
+  pool.ParallelFor(
+      0, kNumChunks,
+      [&](const int chunk) {
+        const int kFirst = chunk * kTriangulationGrainSize;
+        const int kLast =
+            std::min(kNumPoints, kFirst + kTriangulationGrainSize);
+        int num_chunk_refined = 0;
+        for (int i = kFirst; i < kLast; ++i) {
+          const double x1 = correspondences.x1[i], y1 = correspondences.y1[i];
+          const double x2 = correspondences.x2[i], y2 = correspondences.y2[i];
+          uzh::TriangulatePoint(M1.memptr(), M2.memptr(), x1, y1, x2, y2,
+                                P.colptr(i));
+          num_chunk_refined += uzh::RefinePoint(M1.memptr(), M2.memptr(), x1,
+                                                y1, x2, y2, P.colptr(i));
+        }
+        num_points_refined += num_chunk_refined;
+      },
+      1);
+  if (num_refined != nullptr) *num_refined = num_points_refined;
+  return P;
+}
+
+}  // namespace uzh
+
+#endif  // UZH_TWO_VIEW_GEOMETRY_REFINE_TRIANGULATION_H_
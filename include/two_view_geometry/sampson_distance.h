@@ -0,0 +1,85 @@
+#ifndef UZH_TWO_VIEW_GEOMETRY_SAMPSON_DISTANCE_H_
+#define UZH_TWO_VIEW_GEOMETRY_SAMPSON_DISTANCE_H_
+
+#include <vector>
+
+#include "armadillo"
+#include "glog/logging.h"
+#include "two_view_geometry/epipolar_residuals.h"
+
+namespace uzh {
+
+//@brief Point correspondences stored as structure of arrays, such that the
+// residuals of a hypothesis are evaluated over all points with SIMD, see
+// SquaredEpipolarResiduals.
+struct EpipolarCorrespondences {
+  std::vector<double> x1, y1;  // Dehomogenized points on the left camera.
+  std::vector<double> x2, y2;  // Dehomogenized points on the right camera.
+
+  int size() const { return static_cast<int>(x1.size()); }
+};
+
+//@brief Pack point correspondences, optionally mapped by K1^-1 and K2^-1 to
+// normalized image coordinates.
+//@param p1 [3 x n] matrix where each column contains the homogeneous
+// coordinates of image points p1 on the left camera.
+//@param p2 [3 x n] matrix where each column contains the homogeneous
+// coordinates of image points p2 on the right camera.
+//@param K1 [3 x 3] calibration matrix for the left camera. If empty, the points
+// are only dehomogenized.
+//@param K2 [3 x 3] calibration matrix for the right camera.
+EpipolarCorrespondences PackEpipolarCorrespondences(
+    const arma::mat& p1, const arma::mat& p2,
+    const arma::mat& K1 = arma::mat(), const arma::mat& K2 = arma::mat()) {
+  if (p1.n_cols != p2.n_cols)
+    LOG(ERROR) << "Number of points of p1 and p2 must be consistent.";
+  if (p1.n_rows != 3 || p2.n_rows != 3)
+    LOG(ERROR) << "Points must be represented as homogeneous coordinates.";
+
+  const arma::mat q1 = K1.empty() ? p1 : arma::mat(arma::solve(K1, p1));
+  const arma::mat q2 = K2.empty() ? p2 : arma::mat(arma::solve(K2, p2));
+  const int kNumPoints = p1.n_cols;
+  EpipolarCorrespondences correspondences;
+  correspondences.x1.resize(kNumPoints);
+  correspondences.y1.resize(kNumPoints);
+  correspondences.x2.resize(kNumPoints);
+  correspondences.y2.resize(kNumPoints);
+  for (int i = 0; i < kNumPoints; ++i) {
+    correspondences.x1[i] = q1(0, i) / q1(2, i);
+    correspondences.y1[i] = q1(1, i) / q1(2, i);
+    correspondences.x2[i] = q2(0, i) / q2(2, i);
+    correspondences.y2[i] = q2(1, i) / q2(2, i);
+  }
+  return correspondences;
+}
+
+//@brief Squared Sampson distances of all correspondences, see
+// SquaredEpipolarResiduals.
+//@param F [3 x 3] essential or fundamental matrix, matching the coordinates of
+// the correspondences.
+//@param correspondences Correspondences from PackEpipolarCorrespondences.
+//@param distances Output array of correspondences.size() squared distances.
+void SquaredSampsonDistances(const arma::mat& F,
+                             const EpipolarCorrespondences& correspondences,
+                             double* distances) {
+  uzh::SquaredEpipolarResiduals(
+      F, EPIPOLAR_SAMPSON, correspondences.x1.data(),
+      correspondences.y1.data(), correspondences.x2.data(),
+      correspondences.y2.data(), correspondences.size(), distances);
+}
+
+//@brief Number of correspondences whose squared Sampson distance is below
+// squared_threshold, without storing the distances, see CountEpipolarInliers.
+//! This is the scoring loop of RANSAC.
+int CountSampsonInliers(const arma::mat& F,
+                        const EpipolarCorrespondences& correspondences,
+                        const double squared_threshold) {
+  return uzh::CountEpipolarInliers(
+      F, EPIPOLAR_SAMPSON, correspondences.x1.data(),
+      correspondences.y1.data(), correspondences.x2.data(),
+      correspondences.y2.data(), correspondences.size(), squared_threshold);
+}
+
+}  // namespace uzh
+
+#endif  // UZH_TWO_VIEW_GEOMETRY_SAMPSON_DISTANCE_H_
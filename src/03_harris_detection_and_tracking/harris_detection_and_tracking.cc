@@ -1,9 +1,12 @@
+#include <memory>
 #include <string>
+#include <utility>  // std::make_pair
 #include <vector>
 
 #include "Eigen/Dense"
 #include "feature.h"
 #include "glog/logging.h"
+#include "io.h"
 #include "matlab_port.h"
 #include "opencv2/core/eigen.hpp"
 #include "opencv2/opencv.hpp"
@@ -115,7 +118,10 @@ int main(int /*argv*/, char** argv) {
   // dataset.
   // Prepare database containers.
   cv::Mat database_kps, database_descs;
+  std::shared_ptr<const uzh::MappedFeatureFile> database_features;
   const int kNumImages = 200;
+  const bool use_feature_cache = true;
+  uzh::FeatureCache feature_cache(file_path + "features");
   bool plot_matches = true;
   if (plot_matches) {
     for (int i = 0; i < kNumImages; ++i) {
@@ -126,13 +132,39 @@ int main(int /*argv*/, char** argv) {
       cv::cvtColor(img_show, query_img, cv::COLOR_BGR2GRAY, 1);
 
       // Prepare query containers.
-      cv::Mat query_harris, query_kps, query_descs;
+      cv::Mat query_kps, query_descs;
       cv::Mat matches_qd;
 
-      uzh::HarrisResponse(query_img, query_harris, kPatchSize, kHarrisKappa);
-      uzh::SelectKeypoints(query_harris, query_kps, kNumKeypoints,
-                           kNonMaximumRadius);
-      uzh::DescribeKeypoints(query_img, query_kps, query_descs, kPatchRadius);
+      // The features of the sequence are cached on disk and memory-mapped,
+      // hence replaying it skips the detection and description.
+      const std::string kImageFile =
+          cv::format((file_path + "KITTI/%06d.png").c_str(), i);
+      const std::string kParamsKey =
+          cv::format("harris %d %g %d %d %d", kPatchSize, kHarrisKappa,
+                     kNumKeypoints, kNonMaximumRadius, kPatchRadius);
+      const std::shared_ptr<const uzh::MappedFeatureFile> query_features =
+          use_feature_cache
+              ? feature_cache.GetOrCompute(kImageFile, kParamsKey, [&] {
+                  cv::Mat harris, kps, descs;
+                  uzh::HarrisResponse(query_img, harris, kPatchSize,
+                                      kHarrisKappa);
+                  uzh::SelectKeypoints(harris, kps, kNumKeypoints,
+                                       kNonMaximumRadius);
+                  uzh::DescribeKeypoints(query_img, kps, descs, kPatchRadius);
+                  return std::make_pair(kps, descs);
+                })
+              : nullptr;
+      if (query_features != nullptr) {
+        query_kps = query_features->keypoints();
+        query_descs = query_features->descriptors();
+      } else {
+        cv::Mat query_harris;
+        uzh::HarrisResponse(query_img, query_harris, kPatchSize, kHarrisKappa);
+        uzh::SelectKeypoints(query_harris, query_kps, kNumKeypoints,
+                             kNonMaximumRadius);
+        uzh::DescribeKeypoints(query_img, query_kps, query_descs,
+                               kPatchRadius);
+      }
 
       // Match query and database after the first iteration.
       if (i >= 1) {
@@ -151,6 +183,8 @@ int main(int /*argv*/, char** argv) {
           cv::waitKey(0);  // 'Space' key -> pause.
       }
 
+      // Keep the mapping alive as long as the database headers point into it.
+      database_features = query_features;
       database_kps = query_kps;
       database_descs = query_descs;
     }
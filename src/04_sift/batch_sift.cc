@@ -0,0 +1,154 @@
+#include <algorithm>  // std::sort
+#include <atomic>
+#include <cctype>  // std::tolower
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <string>
+#include <tuple>  // std::tie
+#include <utility>  // std::make_pair
+#include <vector>
+
+#include "armadillo"
+#include "google_suite.h"
+#include "io.h"
+#include "opencv2/opencv.hpp"
+#include "parallel.h"
+#include "sift.h"
+#include "transfer.h"
+
+DEFINE_string(images, "data/04_sift/",
+              "Directory whose images are processed, or text file listing the "
+              "paths of the images one per line.");
+DEFINE_string(cache_dir, "data/04_sift/features",
+              "Directory of the feature cache the features are written to.");
+DEFINE_int32(num_threads, 0,
+             "Number of worker threads. Use all hardware threads if not "
+             "positive.");
+DEFINE_int32(max_in_flight, 0,
+             "Maximum number of images being processed at a time, which bounds "
+             "the memory. Use twice the number of threads if not positive.");
+DEFINE_int32(tile_size, 512,
+             "Size of the tiles processed in parallel within an image. If not "
+             "positive, each image is processed by a single streaming task.");
+DEFINE_double(rescale_factor, 1.0, "Factor by which the images are rescaled.");
+DEFINE_bool(quantize, true, "Whether to store uint8 quantized descriptors.");
+
+// Collect the image files of a directory, sorted by name, or the files listed
+// in a text file.
+std::vector<std::string> ListImages(const std::string& images) {
+  std::vector<std::string> files;
+  if (uzh::fs::is_directory(images)) {
+    const std::vector<std::string> kExtensions{".png", ".jpg",  ".jpeg",
+                                               ".pgm", ".bmp",  ".tif",
+                                               ".tiff"};
+    for (const auto& entry : uzh::fs::directory_iterator(images)) {
+      if (!uzh::fs::is_regular_file(entry.status())) continue;
+      std::string extension = entry.path().extension().string();
+      std::transform(extension.begin(), extension.end(), extension.begin(),
+                     [](const unsigned char c) { return std::tolower(c); });
+      if (std::find(kExtensions.begin(), kExtensions.end(), extension) !=
+          kExtensions.end())
+        files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+  } else {
+    std::ifstream list(images);
+    if (!list) LOG(ERROR) << "Cannot open " << images;
+    std::string line;
+    while (std::getline(list, line)) {
+      if (!line.empty()) files.push_back(line);
+    }
+  }
+  return files;
+}
+
+int main(int argc, char** argv) {
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  google::LogToStderr();
+
+  const std::vector<std::string> image_files = ListImages(FLAGS_images);
+  if (image_files.empty()) {
+    LOG(ERROR) << "No images found in " << FLAGS_images;
+    return EXIT_FAILURE;
+  }
+
+  uzh::SIFTParameters params;
+  // Same key as the features cached by the sift executable with the same
+  // settings, such that they are shared.
+  const std::string kParamsKey =
+      uzh::SIFTParametersKey(params) +
+      cv::format(" %s %g %g %d", FLAGS_tile_size > 0 ? "tiled" : "streaming",
+                 FLAGS_rescale_factor, 0.0, FLAGS_quantize);
+  uzh::FeatureCache feature_cache(FLAGS_cache_dir);
+
+  uzh::ThreadPool pool(FLAGS_num_threads);
+  const int kMaxInFlight =
+      FLAGS_max_in_flight > 0 ? FLAGS_max_in_flight : 2 * pool.size();
+
+  // Each image is a task decoding, building the scale space of and describing
+  // the image. The tasks are run one per worker, and the tiles of an image are
+  // stolen by idle workers when there are fewer images in flight than workers.
+  std::atomic<int> num_computed{0};
+  std::atomic<long> num_keypoints{0};
+  const auto process = [&](const std::string& image_file) {
+    const auto features = feature_cache.GetOrCompute(
+        image_file, kParamsKey, [&] {
+          const cv::Mat image =
+              uzh::GetImageSIFT(image_file, FLAGS_rescale_factor);
+          arma::mat descs;
+          arma::umat kpts;
+          std::tie(descs, kpts) =
+              FLAGS_tile_size > 0
+                  ? uzh::TiledSIFT(image, params, FLAGS_tile_size, pool)
+                  : uzh::StreamingSIFT(image, params);
+          ++num_computed;
+          const arma::Mat<int> kpts_int =
+              arma::conv_to<arma::Mat<int>>::from(kpts);
+          if (FLAGS_quantize) {
+            return std::make_pair(
+                cv::Mat(uzh::arma2cv<int>(kpts_int)),
+                cv::Mat(uzh::arma2cv<unsigned char>(
+                    uzh::QuantizeSIFTDescriptors(descs))));
+          }
+          const arma::fmat descs_float = arma::conv_to<arma::fmat>::from(descs);
+          return std::make_pair(cv::Mat(uzh::arma2cv<int>(kpts_int)),
+                                cv::Mat(uzh::arma2cv<float>(descs_float)));
+        });
+    if (features == nullptr) {
+      LOG(ERROR) << "Failed to process " << image_file;
+      return;
+    }
+    num_keypoints += features->keypoints().cols;
+  };
+
+  // Bounded pipeline: at most kMaxInFlight images are submitted and not yet
+  // finished. Waiting on the oldest one helps with pending tasks.
+  const auto start = std::chrono::steady_clock::now();
+  std::deque<std::future<void>> in_flight;
+  for (const std::string& image_file : image_files) {
+    if (static_cast<int>(in_flight.size()) == kMaxInFlight) {
+      pool.Wait(in_flight.front());
+      in_flight.pop_front();
+    }
+    in_flight.push_back(pool.Submit([&, image_file] { process(image_file); }));
+  }
+  while (!in_flight.empty()) {
+    pool.Wait(in_flight.front());
+    in_flight.pop_front();
+  }
+  const double kSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+
+  const int kNumImages = image_files.size();
+  LOG(INFO) << "Processed " << kNumImages << " images ("
+            << kNumImages - num_computed << " cached) with " << pool.size()
+            << " threads in " << kSeconds << " s: "
+            << kNumImages / kSeconds << " images/s, "
+            << num_keypoints / kNumImages << " keypoints per image.";
+
+  return EXIT_SUCCESS;
+}
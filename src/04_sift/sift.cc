@@ -1,13 +1,19 @@
 #include "sift.h"
 
+#include <future>
 #include <string>
 #include <tuple>  // std::tie
+#include <utility>  // std::make_pair
+#include <vector>
 
 #include "armadillo"
 #include "feature/matching.h"
+#include "feature/quantized_matching.h"
 #include "google_suite.h"
+#include "io.h"
 #include "matlab_port.h"
 #include "opencv2/opencv.hpp"
+#include "parallel.h"
 #include "transfer.h"
 
 int main(int /*argc*/, char** argv) {
@@ -29,9 +35,21 @@ int main(int /*argc*/, char** argv) {
   cv::Mat img_1_show = cv::imread(file_path + "img_1.jpg", cv::IMREAD_COLOR);
   cv::Mat img_2_show = cv::imread(file_path + "img_2.jpg", cv::IMREAD_COLOR);
 
-  // Decimate the images for speed.
-  // The original images are [3024 x 4032 x 3] color images.
-  const double kRescaleFactor = 0.3;
+  // Which SIFT engine to run.
+  // Streaming: blurring, DoGs, extremum detection and description are fused
+  // per octave and only a few float32 images are alive at a time, hence the
+  // full resolution images are processed.
+  // Parallel: the pipeline materializing all blurred images and DoGs, run on
+  // the thread pool. Otherwise, the same pipeline run sequentially.
+  const bool use_streaming_sift = true;
+  const bool use_parallel_sift = true;
+  // If positive, the streaming engine processes the octaves in tiles of this
+  // size in parallel.
+  const int kTileSize = 512;
+
+  // The original images are [3024 x 4032 x 3] color images. Only the
+  // materializing pipeline needs them to be decimated.
+  const double kRescaleFactor = use_streaming_sift ? 1.0 : 0.3;
   cv::Mat left_image =
       uzh::GetImageSIFT(file_path + "img_1.jpg", kRescaleFactor);
   cv::Mat right_image =
@@ -48,6 +66,8 @@ int main(int /*argc*/, char** argv) {
     // TODO(bayes) Implement imrotate to do general rotation.
     right_image = uzh::imrotate(right_image, kDegree);
   }
+  // Derotate the patches by the dominant orientations only if needed.
+  const bool kRotationInvariant = kDegree != 0;
 
   // Construct a field of images to be processed iteratively.
   arma::field<cv::Mat> images(2);
@@ -58,23 +78,136 @@ int main(int /*argc*/, char** argv) {
   arma::field<arma::umat> keypoints(2);
   arma::field<arma::mat> descriptors(2);
 
-  for (int i = 0; i < images.size(); ++i) {
+  uzh::SIFTParameters params;
+  params.num_octaves = kNumOctaves;
+  params.num_scales = kNumScales;
+  params.base_sigma = kBaseSigma;
+  params.keypoints_threshold = kKeypointsThreshold;
+  params.rotation_invariant = kRotationInvariant;
+
+  // Features are cached on disk keyed on the image file, its modification
+  // time and the settings below, hence re-running with unchanged settings
+  // skips the detection.
+  const bool use_feature_cache = true;
+  // Quantize the descriptors to uint8 following Lowe, which shrinks them from
+  // 1 KB to 128 bytes and lets them be matched with integer SIMD kernels.
+  const bool use_quantized_descriptors = true;
+  uzh::FeatureCache feature_cache(file_path + "features");
+  const std::string kEngine =
+      use_streaming_sift ? (kTileSize > 0 ? "tiled" : "streaming")
+                         : (use_parallel_sift ? "parallel" : "sequential");
+  const std::vector<std::string> image_files{file_path + "img_1.jpg",
+                                             file_path + "img_2.jpg"};
+  // Only the right image is rotated.
+  const std::vector<double> degrees{0.0, kDegree};
+
+  // Number of extrema removed by each stage of the keypoint refinement.
+  std::vector<uzh::KeypointFilterStats> refinement_stats(images.size());
+  auto detect = [&](const int i) -> std::tuple<arma::mat, arma::umat> {
+    uzh::KeypointFilterStats* stats = &refinement_stats[i];
+    if (use_streaming_sift) {
+      if (kTileSize > 0)
+        return uzh::TiledSIFT(images(i), params, kTileSize,
+                              uzh::ThreadPool::Global(), stats);
+      return uzh::StreamingSIFT(images(i), params, stats);
+    }
+    if (use_parallel_sift) {
+      return uzh::ParallelSIFT(images(i), params, uzh::ThreadPool::Global(),
+                               stats);
+    }
     // Compute the image pyramid.
     // The returned image pyramid contains five images with different
     // resolutions that are later on fed into the ComputeBlurredImages
-    // function to generate images of five octaves with each octave containing 6
-    // images blurred with different sigma values.
+    // function to generate images of five octaves with each octave
+    // containing 6 images blurred with different sigma values.
     const arma::field<cv::Mat> image_pyramid =
         uzh::ComputeImagePyramid(images(i), kNumOctaves);
     const arma::field<arma::cube> blurred_images =
         uzh::ComputeBlurredImages(image_pyramid, kNumScales, kBaseSigma);
     const arma::field<arma::cube> DoGs = uzh::ComputeDoGs(blurred_images);
-    const arma::field<arma::umat> keypoints_tmp =
+    arma::field<arma::umat> keypoints_tmp =
         uzh::ExtractKeypoints(DoGs, kKeypointsThreshold);
-    std::tie(descriptors(i), keypoints(i)) =
-        uzh::ComputeDescriptors(blurred_images, keypoints_tmp, false);
+    // Reject the unstable, low contrast and edge-like extrema before
+    // describing them. The quadratic is fitted to the signed DoGs, as the
+    // derivatives of the absolute ones are wrong where D crosses zero.
+    if (params.refine_keypoints) {
+      keypoints_tmp = uzh::RefineKeypoints(
+          uzh::ComputeDoGs(blurred_images, /*absolute*/ false), keypoints_tmp,
+          params.contrast_threshold, params.edge_ratio, stats);
+    }
+    return uzh::ComputeDescriptors(blurred_images, keypoints_tmp,
+                                   kRotationInvariant);
+  };
+
+  // Quantized descriptors are kept as doubles in [0, 255], which convert back
+  // to uint8 losslessly.
+  auto detect_quantized =
+      [&](const int i) -> std::tuple<arma::mat, arma::umat> {
+    arma::mat descs;
+    arma::umat kpts;
+    std::tie(descs, kpts) = detect(i);
+    if (use_quantized_descriptors)
+      descs =
+          arma::conv_to<arma::mat>::from(uzh::QuantizeSIFTDescriptors(descs));
+    return {descs, kpts};
+  };
+
+  auto detect_cached = [&](const int i) -> std::tuple<arma::mat, arma::umat> {
+    if (!use_feature_cache) return detect_quantized(i);
+    const std::string kParamsKey =
+        uzh::SIFTParametersKey(params) +
+        cv::format(" %s %g %g %d", kEngine.c_str(), kRescaleFactor, degrees[i],
+                   use_quantized_descriptors);
+    const auto features = feature_cache.GetOrCompute(
+        image_files[i], kParamsKey, [&] {
+          arma::mat descs;
+          arma::umat kpts;
+          std::tie(descs, kpts) = detect_quantized(i);
+          const arma::Mat<int> kpts_int =
+              arma::conv_to<arma::Mat<int>>::from(kpts);
+          const cv::Mat kpts_cv = uzh::arma2cv<int>(kpts_int);
+          if (use_quantized_descriptors) {
+            const arma::Mat<unsigned char> descs_uint8 =
+                arma::conv_to<arma::Mat<unsigned char>>::from(descs);
+            return std::make_pair(
+                kpts_cv, cv::Mat(uzh::arma2cv<unsigned char>(descs_uint8)));
+          }
+          const arma::fmat descs_float = arma::conv_to<arma::fmat>::from(descs);
+          return std::make_pair(kpts_cv,
+                                cv::Mat(uzh::arma2cv<float>(descs_float)));
+        });
+    if (features == nullptr) return detect_quantized(i);
+
+    // Copy the mapped features back to armadillo for display and matching.
+    cv::Mat descs;
+    features->descriptors().convertTo(descs, CV_64F);
+    const arma::umat kpts_arma = arma::conv_to<arma::umat>::from(
+        uzh::cv2arma<int>(features->keypoints()).t());
+    const arma::mat descs_arma = uzh::cv2arma<double>(descs).t();
+    return {descs_arma, kpts_arma};
+  };
+
+  // The two images are processed concurrently. Within each image, the
+  // parallel and tiled engines also process the octaves, the scale slices or
+  // the tiles concurrently.
+  uzh::ThreadPool& pool = uzh::ThreadPool::Global();
+  std::vector<std::future<std::tuple<arma::mat, arma::umat>>> futures;
+  for (int i = 0; i < images.size(); ++i) {
+    futures.push_back(pool.Submit([&, i] { return detect_cached(i); }));
+  }
+  for (int i = 0; i < images.size(); ++i) {
+    std::tie(descriptors(i), keypoints(i)) = pool.Wait(futures[i]);
     LOG(INFO) << "Detected " << keypoints(i).n_cols << " keypoints on img_"
               << i + 1;
+    // The counts are only available if the features were not cached.
+    const uzh::KeypointFilterStats& stats = refinement_stats[i];
+    if (params.refine_keypoints && stats.num_candidates > 0) {
+      LOG(INFO) << "Refinement of the " << stats.num_candidates
+                << " extrema of img_" << i + 1 << " removed "
+                << stats.num_unstable << " unstable, " << stats.num_low_contrast
+                << " low contrast and " << stats.num_edge
+                << " edge-like ones, kept " << stats.num_kept();
+    }
   }
 
   // Display detected keypoints
@@ -87,24 +220,38 @@ int main(int /*argc*/, char** argv) {
                  {static_cast<int>(kpts_x(i)), static_cast<int>(kpts_y(i))}, 4,
                  {50, 50, 255}, cv::FILLED);
     }
-    cv::imshow(cv::format("Detected SIFT keypoints on img_%d", img_idx + 1),
-               imgs_show(img_idx));
+    const std::string kWindowName =
+        cv::format("Detected SIFT keypoints on img_%d", img_idx + 1);
+    // Resizable window such that full resolution images fit on the screen.
+    cv::namedWindow(kWindowName, cv::WINDOW_NORMAL);
+    cv::imshow(kWindowName, imgs_show(img_idx));
     cv::waitKey(0);
   }
 
   // Match descriptors
-  // TODO Implement matchFeatures extending simple thresholding based matching
-  // to distance ratio rejection based matching.
-  // FIXME Possible errors.
-  cv::Mat query_descriptor, database_descriptor;
-  query_descriptor = uzh::arma2cv<double>(descriptors(0));
-  database_descriptor = uzh::arma2cv<double>(descriptors(1));
-  cv::Mat matches;
-  uzh::MatchDescriptors(query_descriptor, database_descriptor, matches, 3);
-  arma::umat match_indices = uzh::cv2arma<arma::uword>(matches);
-  // FIXME Will the arma::find discard 0 index which is matched though?
-  LOG(INFO) << "Number of matched keypoint pairs: "
-            << arma::size(arma::find(match_indices)).n_rows;
+  if (use_quantized_descriptors) {
+    // Distance ratio test on the uint8 descriptors with integer distances.
+    const double kMaxRatio = 0.8;
+    arma::umat index_pairs;
+    std::tie(index_pairs, std::ignore) = uzh::MatchQuantizedDescriptors(
+        arma::conv_to<arma::Mat<unsigned char>>::from(descriptors(0)),
+        arma::conv_to<arma::Mat<unsigned char>>::from(descriptors(1)),
+        kMaxRatio);
+    LOG(INFO) << "Number of matched keypoint pairs: " << index_pairs.n_cols;
+  } else {
+    // TODO Implement matchFeatures extending simple thresholding based
+    // matching to distance ratio rejection based matching.
+    // FIXME Possible errors.
+    cv::Mat query_descriptor, database_descriptor;
+    query_descriptor = uzh::arma2cv<double>(descriptors(0));
+    database_descriptor = uzh::arma2cv<double>(descriptors(1));
+    cv::Mat matches;
+    uzh::MatchDescriptors(query_descriptor, database_descriptor, matches, 3);
+    arma::umat match_indices = uzh::cv2arma<arma::uword>(matches);
+    // FIXME Will the arma::find discard 0 index which is matched though?
+    LOG(INFO) << "Number of matched keypoint pairs: "
+              << arma::size(arma::find(match_indices)).n_rows;
+  }
 
   // Display matched keypoints
   //! Not intended to reinvent the wheel.
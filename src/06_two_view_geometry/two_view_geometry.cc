@@ -30,7 +30,24 @@ int main(int /*argc*/, char** argv) {
 
   // Estimate essential matrix E.
   // Assume K1 = K2 = K.
-  const arma::mat E = uzh::EstimateEssentialMatrix(p1_h, p2_h, K, K);
+  // If use_ransac, E is estimated robustly and only the inlier
+  // correspondences are used to disambiguate the poses and triangulate.
+  const bool use_ransac = true;
+  arma::mat E;
+  arma::mat p1_h_inliers = p1_h, p2_h_inliers = p2_h;
+  if (use_ransac) {
+    const double kPixelTolerance = 1.0;
+    arma::urowvec inlier_mask;
+    std::tie(E, inlier_mask) =
+        uzh::EstimateEssentialMatrixRANSAC(p1_h, p2_h, K, K, kPixelTolerance);
+    const arma::uvec inliers = arma::find(inlier_mask);
+    p1_h_inliers = p1_h.cols(inliers);
+    p2_h_inliers = p2_h.cols(inliers);
+    LOG(INFO) << "RANSAC: " << inliers.n_elem << " inliers out of "
+              << p1_h.n_cols << " correspondences.";
+  } else {
+    E = uzh::EstimateEssentialMatrix(p1_h, p2_h, K, K);
+  }
 
   // Decompose E get Rs and u;
   arma::field<arma::mat> Rs;
@@ -38,9 +55,13 @@ int main(int /*argc*/, char** argv) {
   std::tie(Rs, u) = uzh::DecomposeEssentialMatrix(E);
 
   // Disambiguate combinations of R and t.
+  // The combinations are voted on by a random subset of the correspondences
+  // first, and by all of them only if the vote is not decisive.
+  const int kNumCheiralitySamples = 100;
   arma::mat R;
   arma::mat t;
-  std::tie(R, t) = uzh::DisambiguateRelativePoses(Rs, u, p1_h, p2_h, K, K);
+  std::tie(R, t) = uzh::DisambiguateRelativePoses(
+      Rs, u, p1_h_inliers, p2_h_inliers, K, K, kNumCheiralitySamples);
 
   // Triangulate a point cloud from the views.
   const arma::mat M1 = K * arma::eye<arma::mat>(3, 4);
@@ -51,9 +72,9 @@ int main(int /*argc*/, char** argv) {
   if (use_nonlinear_triangulation) {
     // Use nonlinear triangulation to get a more accurate P.
     LOG(WARNING) << "Nonlinear triangulation risks to overfitting.";
-    P = uzh::NonlinearTriangulation(p1_h, p2_h, M1, M2);
+    P = uzh::NonlinearTriangulation(p1_h_inliers, p2_h_inliers, M1, M2);
   } else {
-    P = uzh::LinearTriangulation(p1_h, p2_h, M1, M2);
+    P = uzh::LinearTriangulation(p1_h_inliers, p2_h_inliers, M1, M2);
   }
   // FIXME P is okay in macOS but bad in Ubuntu.
 
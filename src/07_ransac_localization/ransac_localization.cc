@@ -1,7 +1,10 @@
 #include <functional>
+#include <memory>
 #include <random>
 #include <string>
 #include <tuple>
+#include <utility>  // std::make_pair
+#include <vector>
 
 #include "Eigen/Dense"
 #include "armadillo"
@@ -10,10 +13,65 @@
 #include "io.h"
 #include "matlab_port.h"
 #include "opencv2/opencv.hpp"
+#include "parallel.h"
 #include "pcl/visualization/pcl_plotter.h"
 #include "ransac.h"
 #include "transfer.h"
 
+DEFINE_bool(batch_localization, true,
+            "If true, the query frames are localized concurrently before being "
+            "displayed in order. Otherwise they are processed one by one.");
+DEFINE_int32(num_threads, 0,
+             "Number of worker threads used in batch localization. Use all "
+             "hardware threads if not positive.");
+DEFINE_bool(parallel_ransac, false,
+            "If true, the hypotheses of RANSAC are generated and scored in "
+            "parallel on the global thread pool.");
+DEFINE_int32(ransac_seed, -1,
+             "If non-negative, parallel RANSAC is deterministic with this "
+             "seed. Otherwise the workers are seeded randomly.");
+DEFINE_bool(prosac, true,
+            "If true, RANSAC samples the matches with the smallest descriptor "
+            "distances first. Otherwise it samples uniformly.");
+DEFINE_bool(sprt, false,
+            "If true, sequential RANSAC rejects bad hypotheses early with "
+            "SPRT instead of scoring all correspondences.");
+
+//@brief Dispatch to RANSACLocalization or ParallelRANSACLocalization according
+// to the flags.
+//@param match_distances Descriptor distances of the matches, ranking them for
+// PROSAC.
+std::tuple<arma::mat33, arma::vec3, arma::urowvec, arma::urowvec,
+           arma::rowvec>
+LocalizeWithRANSAC(const arma::umat& keypoints, const arma::mat& landmarks,
+                   const arma::mat& K, const arma::rowvec& match_distances) {
+  // The smaller the distance, the more reliable the match.
+  const arma::rowvec quality =
+      FLAGS_prosac ? arma::rowvec(-match_distances) : arma::rowvec();
+  if (!FLAGS_parallel_ransac)
+    return uzh::RANSACLocalization(keypoints, landmarks, K, uzh::P3P, true,
+                                   true, quality, FLAGS_sprt);
+  const bool kDeterministic = FLAGS_ransac_seed >= 0;
+  const unsigned kSeed =
+      kDeterministic ? FLAGS_ransac_seed : std::random_device()();
+  return uzh::ParallelRANSACLocalization(keypoints, landmarks, K, uzh::P3P,
+                                         true, true, quality, kDeterministic,
+                                         kSeed);
+}
+
+// Per-frame result of detection, description, matching and RANSAC.
+struct FrameLocalization {
+  cv::Mat query_img;
+  cv::Mat query_kpts_cv;
+  arma::umat query_keypoints_arma;
+  arma::urowvec all_matches;
+  arma::umat matched_query_kpts;
+  arma::urowvec corresponding_matches;
+  arma::mat33 R_C_W;
+  arma::vec3 t_C_W;
+  arma::urowvec inlier_mask;
+};
+
 int main(int argc, char** argv) {
   GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, false);
   google::InitGoogleLogging(argv[0]);
@@ -57,7 +115,7 @@ int main(int argc, char** argv) {
   arma::mat best_poly_coeffs;
   arma::urowvec max_inlier_counts;
   std::tie(best_poly_coeffs, max_inlier_counts) =
-      uzh::ParabolaRANSAC(data, max_noise);
+      uzh::ParabolaRANSAC(data, max_noise, 100, FLAGS_sprt);
 
   // Compare various fits with RANSAC.
   pcl::visualization::PCLPlotter* plotter(
@@ -169,9 +227,9 @@ int main(int argc, char** argv) {
   uzh::DescribeKeypoints(query_image, query_keypoints_cv, query_descriptors,
                          kDescriptorPatchRadius);
   // Match descriptors.
-  cv::Mat matches_cv;
+  cv::Mat matches_cv, match_distances_cv;
   uzh::MatchDescriptors(query_descriptors, database_descriptors, matches_cv,
-                        kDistanceRatio);
+                        kDistanceRatio, &match_distances_cv);
   // Obtain matched query keypoints and corresponding landmarks.
   // Convert from cv::Mat to arma::Mat
   const arma::umat query_keypoints_arma = arma::conv_to<arma::umat>::from(
@@ -185,6 +243,10 @@ int main(int argc, char** argv) {
       all_matches(arma::find(all_matches > 0)).as_row();
   const arma::mat corresponding_landmarks =
       p_W_landmarks.cols(corresponding_matches);
+  const arma::rowvec all_match_distances =
+      uzh::cv2arma<double>(match_distances_cv).as_row();
+  const arma::rowvec corresponding_match_distances =
+      all_match_distances(arma::find(all_matches > 0)).as_row();
 
   // Use these matched 3D-2D correspondences to find pose and best inlier
   // matches using RANSAC.
@@ -194,8 +256,8 @@ int main(int argc, char** argv) {
   arma::rowvec num_iterations_history;
   std::tie(R_C_W, t_C_W, inlier_mask, max_num_inliers_history,
            num_iterations_history) =
-      uzh::RANSACLocalization(matched_query_keypoints, corresponding_landmarks,
-                              K);
+      LocalizeWithRANSAC(matched_query_keypoints, corresponding_landmarks, K,
+                         corresponding_match_distances);
   // Show the result.
   arma::mat44 T_C_W(arma::fill::eye);
   T_C_W(0, 0, arma::size(3, 3)) = R_C_W;
@@ -283,49 +345,98 @@ int main(int argc, char** argv) {
 
   // Apply RANSAC to all frames
   // Every subsequent frame is matched against the first frame.
+  //! The frames are independent of each other, hence in batch mode they are
+  //! localized concurrently on a work-stealing pool and shown in order
+  //! afterwards. The database descriptors computed above are shared read-only
+  //! by all workers.
   const int kNumFrames = 9;
   const std::string winname{"All matches vs. inlier matches found with RANSAC"};
-  for (int i = 1; i < kNumFrames + 1; ++i) {
-    cv::Mat query_img =
+  std::vector<FrameLocalization> frames(kNumFrames);
+  // The features of the frames are cached on disk and memory-mapped, hence
+  // re-running skips the detection and description.
+  uzh::FeatureCache feature_cache(file_path + "features");
+  const std::string kFeatureParamsKey =
+      cv::format("harris %d %g %d %d %d", kPatchSize, kHarrisKappa,
+                 kNumKeypoints, kNonMaximumRadius, kDescriptorPatchRadius);
+  const auto localize_frame = [&](const int i) {
+    FrameLocalization& frame = frames[i - 1];
+    frame.query_img =
         cv::imread(cv::format((file_path + "KITTI/%06d.png").c_str(), i),
                    cv::IMREAD_GRAYSCALE);
 
-    // Detect Harris keypoints in the query image.
-    cv::Mat harris_res;
-    uzh::HarrisResponse(query_img, harris_res, kPatchSize, kHarrisKappa);
-    cv::Mat query_kpts_cv;
-    uzh::SelectKeypoints(harris_res, query_kpts_cv, kNumKeypoints,
-                         kNonMaximumRadius);
-    // Describe keypoints.
+    // Detect and describe Harris keypoints in the query image, or map them
+    // from the feature cache if this frame was processed before.
+    const auto detect_and_describe = [&] {
+      cv::Mat harris_res, kpts, descs;
+      uzh::HarrisResponse(frame.query_img, harris_res, kPatchSize,
+                          kHarrisKappa);
+      uzh::SelectKeypoints(harris_res, kpts, kNumKeypoints, kNonMaximumRadius);
+      uzh::DescribeKeypoints(frame.query_img, kpts, descs,
+                             kDescriptorPatchRadius);
+      return std::make_pair(kpts, descs);
+    };
+    const std::shared_ptr<const uzh::MappedFeatureFile> query_features =
+        feature_cache.GetOrCompute(
+            cv::format((file_path + "KITTI/%06d.png").c_str(), i),
+            kFeatureParamsKey, detect_and_describe);
     cv::Mat query_descs;
-    uzh::DescribeKeypoints(query_img, query_kpts_cv, query_descs,
-                           kDescriptorPatchRadius);
+    if (query_features != nullptr) {
+      // The keypoints outlive the mapping in frame, hence they are copied.
+      // The descriptors are matched in place.
+      frame.query_kpts_cv = query_features->keypoints().clone();
+      query_descs = query_features->descriptors();
+    } else {
+      std::tie(frame.query_kpts_cv, query_descs) = detect_and_describe();
+    }
     // Match descriptors.
-    cv::Mat matches_cv_frame_i;
+    cv::Mat matches_cv_frame_i, match_distances_cv_frame_i;
     uzh::MatchDescriptors(query_descs, database_descriptors, matches_cv_frame_i,
-                          kDistanceRatio);
+                          kDistanceRatio, &match_distances_cv_frame_i);
     // Obtain matched query keypoints and corresponding landmarks.
     // Convert from cv::Mat to arma::Mat
-    const arma::umat query_keypoints_arma_frame_i =
-        arma::conv_to<arma::umat>::from(uzh::cv2arma<int>(query_kpts_cv).t());
-    const arma::urowvec all_matches_frame_i =
-        arma::conv_to<arma::urowvec>::from(
-            uzh::cv2arma<int>(matches_cv_frame_i).t());
-    const arma::umat matched_query_kpts =
-        query_keypoints_arma_frame_i.cols(arma::find(all_matches_frame_i > 0));
+    frame.query_keypoints_arma = arma::conv_to<arma::umat>::from(
+        uzh::cv2arma<int>(frame.query_kpts_cv).t());
+    frame.all_matches = arma::conv_to<arma::urowvec>::from(
+        uzh::cv2arma<int>(matches_cv_frame_i).t());
+    frame.matched_query_kpts =
+        frame.query_keypoints_arma.cols(arma::find(frame.all_matches > 0));
     //! The result of linear indexing is always a column vector in Armadillo.
-    const arma::urowvec corresponding_matches_frame_i =
-        all_matches_frame_i(arma::find(all_matches_frame_i > 0)).as_row();
+    frame.corresponding_matches =
+        frame.all_matches(arma::find(frame.all_matches > 0)).as_row();
     const arma::mat corresponding_landmarks_frame_i =
-        p_W_landmarks.cols(corresponding_matches_frame_i);
+        p_W_landmarks.cols(frame.corresponding_matches);
+    const arma::rowvec all_match_distances_frame_i =
+        uzh::cv2arma<double>(match_distances_cv_frame_i).as_row();
+    const arma::rowvec corresponding_match_distances_frame_i =
+        all_match_distances_frame_i(arma::find(frame.all_matches > 0))
+            .as_row();
 
     // Use these matched 3D-2D correspondences to find pose and best inlier
     // matches using RANSAC.
-    arma::urowvec inlier_mask_frame_i;
-    std::tie(std::ignore, std::ignore, inlier_mask_frame_i, std::ignore,
+    //! Armadillo's RNG is thread local, so each worker seeds its own.
+    arma::arma_rng::set_seed_random();
+    std::tie(frame.R_C_W, frame.t_C_W, frame.inlier_mask, std::ignore,
              std::ignore) =
-        uzh::RANSACLocalization(matched_query_kpts,
-                                corresponding_landmarks_frame_i, K);
+        LocalizeWithRANSAC(frame.matched_query_kpts,
+                           corresponding_landmarks_frame_i, K,
+                           corresponding_match_distances_frame_i);
+  };
+  if (FLAGS_batch_localization) {
+    uzh::ThreadPool pool(FLAGS_num_threads);
+    pool.ParallelFor(1, kNumFrames + 1, localize_frame, 1);
+  }
+
+  for (int i = 1; i < kNumFrames + 1; ++i) {
+    if (!FLAGS_batch_localization) localize_frame(i);
+    const FrameLocalization& frame = frames[i - 1];
+    const cv::Mat& query_img = frame.query_img;
+    const cv::Mat& query_kpts_cv = frame.query_kpts_cv;
+    const arma::umat& query_keypoints_arma_frame_i = frame.query_keypoints_arma;
+    const arma::urowvec& all_matches_frame_i = frame.all_matches;
+    const arma::umat& matched_query_kpts = frame.matched_query_kpts;
+    const arma::urowvec& corresponding_matches_frame_i =
+        frame.corresponding_matches;
+    const arma::urowvec& inlier_mask_frame_i = frame.inlier_mask;
 
     // Show the result only if RANSAC succeeds.
     if (inlier_mask_frame_i.empty()) {